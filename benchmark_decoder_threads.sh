@@ -0,0 +1,43 @@
+#!/bin/bash
+
+# 디코더 스레드 모드별 처리량 비교 스크립트
+# media/samples의 각 파일을 스레드 설정별로 디코딩하고 코덱별 속도 향상을 표로 출력합니다
+#
+# 사용법: ./benchmark_decoder_threads.sh [샘플 디렉토리]
+#   THREADS=8 ./benchmark_decoder_threads.sh   # 스레드 수 지정 (기본: CPU 코어 수)
+
+SAMPLES_DIR=${1:-media/samples}
+ANALYZER=./build/video-analysis
+PROBE=./build/ffmpeg-info
+THREADS=${THREADS:-$(nproc 2>/dev/null || sysctl -n hw.ncpu)}
+
+if [ ! -x "$ANALYZER" ] || [ ! -x "$PROBE" ]; then
+    echo "Build the project first (cmake -B build -S . && cmake --build build)"
+    exit 1
+fi
+
+# video-analysis 출력에서 디코딩 속도(fps)만 추출
+decode_fps() {
+    "$ANALYZER" --threads "$2" --thread-type "$3" "$1" 2>/dev/null | awk '/^Decode speed:/ { print $3 }'
+}
+
+echo "=== Decoder threading benchmark ($THREADS threads) ==="
+printf "%-28s %-8s %10s %16s %16s %16s\n" "File" "Codec" "1 thread" "frame" "slice" "auto"
+
+for file in "$SAMPLES_DIR"/*; do
+    [ -f "$file" ] || continue
+
+    codec=$("$PROBE" --format ndjson "$file" | sed -n 's/.*"type":"video","codec":"\([^"]*\)".*/\1/p')
+    [ -n "$codec" ] || continue
+
+    base=$(decode_fps "$file" 1 auto)
+    [ -n "$base" ] || continue
+
+    row=$(printf "%-28s %-8s %10.1f" "$(basename "$file")" "$codec" "$base")
+    for mode in frame slice auto; do
+        fps=$(decode_fps "$file" "$THREADS" "$mode")
+        cell=$(awk -v fps="$fps" -v base="$base" 'BEGIN { if (fps == "" || base == 0) print "-"; else printf "%.1f (x%.2f)", fps, fps / base }')
+        row="$row $(printf "%16s" "$cell")"
+    done
+    echo "$row"
+done
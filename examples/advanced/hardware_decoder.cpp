@@ -1,6 +1,8 @@
 #include <iostream>
 #include <chrono>
 #include <iomanip>
+#include <string>
+#include <vector>
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -15,27 +17,65 @@ extern "C" {
 #endif
 }
 
-// 하드웨어 픽셀 포맷 선택 함수
+#include "../decoder_threading.h"
+
+// 디코딩 백엔드: 소프트웨어(device_type = NONE) 또는 FFmpeg에 빌드된 하드웨어 장치 유형
+struct DecoderBackend {
+    AVHWDeviceType device_type = AV_HWDEVICE_TYPE_NONE;
+    AVPixelFormat hw_pix_fmt = AV_PIX_FMT_NONE;   // 디코더가 이 장치로 출력하는 프레임 포맷
+    AVBufferRef* device_ctx = nullptr;            // 장치를 열 수 있을 때만 생성
+    bool available = false;
+    std::string note;                             // 사용할 수 없는 이유
+    
+    bool is_hardware() const { return device_type != AV_HWDEVICE_TYPE_NONE; }
+    const char* name() const { return is_hardware() ? av_hwdevice_get_type_name(device_type) : "software"; }
+};
+
+// 하드웨어 픽셀 포맷 선택 함수: 백엔드의 포맷이 없으면 소프트웨어 포맷으로 대체
 static enum AVPixelFormat get_hw_format(AVCodecContext *ctx, const enum AVPixelFormat *pix_fmts) {
+    const DecoderBackend* backend = static_cast<const DecoderBackend*>(ctx->opaque);
     const enum AVPixelFormat *p;
     
     for (p = pix_fmts; *p != AV_PIX_FMT_NONE; p++) {
-#ifdef __APPLE__
-        if (*p == AV_PIX_FMT_VIDEOTOOLBOX) {
+        if (*p == backend->hw_pix_fmt) {
+            return *p;
+        }
+    }
+    
+    for (p = pix_fmts; *p != AV_PIX_FMT_NONE; p++) {
+        const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(*p);
+        if (desc && !(desc->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+            std::cerr << "[WARN] " << backend->name() << " cannot decode this stream, falling back to software" << std::endl;
             return *p;
         }
-#endif
     }
     
     std::cerr << "Failed to get HW surface format." << std::endl;
     return AV_PIX_FMT_NONE;
 }
 
+// 백엔드 하나의 디코딩 결과
+struct BenchmarkResult {
+    std::string backend;
+    std::string threads;
+    int frame_count = 0;
+    int hw_frame_count = 0;
+    int sw_frame_count = 0;
+    int loop_count = 0;
+    double wall_seconds = 0.0;
+    double cpu_seconds = 0.0;
+    double transfer_seconds = 0.0;   // 하드웨어 프레임 → 시스템 메모리 전송 시간
+    bool software_fallback = false;  // 하드웨어 백엔드가 스트림을 처리하지 못해 소프트웨어로 디코딩
+    bool ok = false;
+};
+
 class HardwareAcceleratedDecoder {
 private:
     AVFormatContext* format_ctx = nullptr;
     AVCodecContext* codec_ctx = nullptr;
-    AVBufferRef* hw_device_ctx = nullptr;
+    const AVCodec* codec = nullptr;
+    std::vector<DecoderBackend> backends;
+    const DecoderBackend* backend = nullptr;
     int video_stream_index = -1;
     
 public:
@@ -43,23 +83,6 @@ public:
         cleanup();
     }
     
-    bool initialize_hardware_acceleration() {
-#ifdef __APPLE__
-        // M1 Mac의 VideoToolbox 하드웨어 가속 초기화
-        int ret = av_hwdevice_ctx_create(&hw_device_ctx, AV_HWDEVICE_TYPE_VIDEOTOOLBOX, nullptr, nullptr, 0);
-        if (ret < 0) {
-            print_error("Failed to create VideoToolbox device context", ret);
-            return false;
-        }
-        std::cout << "[OK] VideoToolbox hardware acceleration initialized successfully!" << std::endl;
-        return true;
-#else
-        // Windows 및 기타 플랫폼에서는 소프트웨어 디코딩 사용
-        std::cout << "[WARN] Hardware acceleration not available on this platform, using software decoding" << std::endl;
-        return false;
-#endif
-    }
-    
     bool open_file(const char* filename) {
         // Open input file
         int ret = avformat_open_input(&format_ctx, filename, nullptr, nullptr);
@@ -88,35 +111,51 @@ public:
             return false;
         }
         
-        // Get codec parameters
+        // 하드웨어 가속은 일반 디코더에 장치를 붙이는 방식이므로 기본 디코더를 사용
         AVCodecParameters* codecpar = format_ctx->streams[video_stream_index]->codecpar;
-        
-        // Find decoder that supports hardware acceleration
-        const AVCodec* codec = nullptr;
-        bool is_hardware_decoder = false;
-        
-        // 먼저 일반 디코더를 찾고, 하드웨어 가속은 별도로 설정
-        // _by_name
         codec = avcodec_find_decoder(codecpar->codec_id);
         if (!codec) {
             std::cerr << "Decoder not found for codec: " << avcodec_get_name(codecpar->codec_id) << std::endl;
             return false;
         }
         
-        // VideoToolbox 하드웨어 가속 지원 코덱인지 확인
-        if (codecpar->codec_id == AV_CODEC_ID_H264 || codecpar->codec_id == AV_CODEC_ID_HEVC) {
-            // 하드웨어 가속이 가능한 코덱
-            is_hardware_decoder = true;
-            std::cout << "[INFO] Found " << avcodec_get_name(codecpar->codec_id) << " decoder with VideoToolbox support" << std::endl;
-        } else {
-            std::cout << "ℹ️  Using software decoder for codec: " << avcodec_get_name(codecpar->codec_id) << std::endl;
-            is_hardware_decoder = false;
+        find_backends();
+        return true;
+    }
+    
+    const std::vector<DecoderBackend>& get_backends() const { return backends; }
+    
+    // "auto"는 첫 번째로 사용 가능한 하드웨어 백엔드, 없으면 소프트웨어
+    const DecoderBackend* select_backend(const std::string& name) const {
+        for (const DecoderBackend& candidate : backends) {
+            if (name == "auto" ? candidate.available && candidate.is_hardware() : name == candidate.name()) {
+                if (!candidate.available) {
+                    std::cerr << name << " backend is not available: " << candidate.note << std::endl;
+                    return nullptr;
+                }
+                return &candidate;
+            }
         }
-        
-        if (!codec) {
-            std::cerr << "Unsupported codec" << std::endl;
-            return false;
+        if (name == "auto") {
+            std::cout << "[INFO] No hardware decoding device found, using multi-threaded software decoding" << std::endl;
+            return &backends.front();
         }
+        std::cerr << "Unknown backend: " << name << " (see --list-backends)" << std::endl;
+        return nullptr;
+    }
+    
+    void print_backends() const {
+        std::cout << "Decoder backends for " << codec->name << ":" << std::endl;
+        for (const DecoderBackend& candidate : backends) {
+            std::cout << "  " << std::left << std::setw(14) << candidate.name()
+                      << (candidate.available ? "available" : candidate.note) << std::endl;
+        }
+    }
+    
+    // 백엔드마다 디코더를 새로 열어 같은 입력을 처음부터 디코딩
+    bool open_decoder(const DecoderBackend& selected, const DecoderThreading& threading) {
+        avcodec_free_context(&codec_ctx);
+        backend = &selected;
         
         // Allocate codec context
         codec_ctx = avcodec_alloc_context3(codec);
@@ -126,17 +165,22 @@ public:
         }
         
         // Copy codec parameters to context
-        ret = avcodec_parameters_to_context(codec_ctx, codecpar);
+        int ret = avcodec_parameters_to_context(codec_ctx, format_ctx->streams[video_stream_index]->codecpar);
         if (ret < 0) {
             print_error("Could not copy codec parameters", ret);
             return false;
         }
         
-        // Set hardware device context if using hardware decoder
-        if (hw_device_ctx && is_hardware_decoder) {
-            codec_ctx->hw_device_ctx = av_buffer_ref(hw_device_ctx);
+        // 하드웨어 백엔드도 같은 스레드 설정을 사용: get_format이 소프트웨어 포맷으로
+        // 대체하더라도 단일 스레드가 아닌 모든 코어로 디코딩
+        if (!configure_decoder_threads(codec_ctx, threading)) {
+            return false;
+        }
+        if (selected.is_hardware()) {
+            // 하드웨어 장치 컨텍스트 연결; get_format이 백엔드의 포맷을 고름
+            codec_ctx->hw_device_ctx = av_buffer_ref(selected.device_ctx);
+            codec_ctx->opaque = const_cast<DecoderBackend*>(&selected);
             codec_ctx->get_format = get_hw_format;
-            std::cout << "🔧 Hardware device context attached to codec" << std::endl;
         }
         
         // Open codec
@@ -146,161 +190,238 @@ public:
             return false;
         }
         
-        // 실제 하드웨어 가속 여부 확인
-        if (is_hardware_decoder && codec_ctx->hw_device_ctx) {
-            std::cout << "[OK] Hardware acceleration confirmed and active" << std::endl;
+        if (selected.is_hardware()) {
+            std::cout << "[OK] " << selected.name() << " hardware acceleration initialized ("
+                      << av_get_pix_fmt_name(selected.hw_pix_fmt) << " frames)" << std::endl;
+        } else {
+            std::cout << "[OK] Software decoding: " << codec->name << ", " << thread_description() << std::endl;
         }
-        
-        return true;
+        return rewind();
     }
     
-    void benchmark_decoding(bool enable_loop = false) {
+    BenchmarkResult benchmark_decoding(bool enable_loop = false, bool verbose = true) {
+        BenchmarkResult result;
+        result.backend = backend->name();
+        result.threads = thread_description();
+        
         AVPacket* packet = av_packet_alloc();
         AVFrame* frame = av_frame_alloc();
         AVFrame* sw_frame = av_frame_alloc(); // 하드웨어 프레임 전송용
         
         if (!packet || !frame || !sw_frame) {
             std::cerr << "Could not allocate packet or frame" << std::endl;
-            return;
+            av_packet_free(&packet);
+            av_frame_free(&frame);
+            av_frame_free(&sw_frame);
+            return result;
         }
         
-        int frame_count = 0;
-        int hw_frame_count = 0;
-        int sw_frame_count = 0;
-        int loop_count = 0;
-        auto start_time = std::chrono::high_resolution_clock::now();
-        auto frame_start_time = start_time;
-        
-        std::cout << "\n=== Hardware Accelerated Decoding Benchmark ===" << std::endl;
-        std::cout << "Codec: " << codec_ctx->codec->name << std::endl;
-        std::cout << "Hardware acceleration: " << (codec_ctx->hw_device_ctx ? "YES (VideoToolbox)" : "NO (Software)") << std::endl;
-        std::cout << "Resolution: " << codec_ctx->width << "x" << codec_ctx->height << std::endl;
-        std::cout << "Loop mode: " << (enable_loop ? "ENABLED" : "DISABLED") << std::endl;
-        std::cout << "----------------------------------------" << std::endl;
+        if (verbose) {
+            std::cout << "\n=== Hardware Accelerated Decoding Benchmark ===" << std::endl;
+            std::cout << "Codec: " << codec_ctx->codec->name << std::endl;
+            std::cout << "Backend: " << backend->name() << " (" << result.threads << ")" << std::endl;
+            std::cout << "Resolution: " << codec_ctx->width << "x" << codec_ctx->height << std::endl;
+            std::cout << "Loop mode: " << (enable_loop ? "ENABLED" : "DISABLED") << std::endl;
+            std::cout << "----------------------------------------" << std::endl;
+        }
         
         // 최대 실행 시간 (루프 모드에서 무한 실행 방지)
         const auto max_duration = std::chrono::seconds(enable_loop ? 10 : 300);
+        auto start_time = std::chrono::high_resolution_clock::now();
+        double start_cpu = cpu_seconds();
+        bool ok = true;
         
-        while (true) {
+        while (ok) {
             int ret = av_read_frame(format_ctx, packet);
             
-            // 파일 끝 처리 (GUI에서 개선한 루프 로직 적용)
+            // 파일 끝: 디코더에 남은 프레임(프레임 스레드 수만큼 지연)을 모두 받은 뒤 종료 또는 루프
             if (ret < 0) {
-                if (ret == AVERROR_EOF && enable_loop) {
-                    loop_count++;
-                    std::cout << "🔄 Loop " << loop_count << ": 파일 끝 도달, 처음부터 다시 재생 (총 " << frame_count << " 프레임 처리)" << std::endl;
-                    
-                    // 디코더 상태 초기화
-                    avcodec_flush_buffers(codec_ctx);
-                    
-                    // 파일 시작으로 seek
-                    if (avformat_seek_file(format_ctx, video_stream_index, 0, 0, 0, AVSEEK_FLAG_FRAME) < 0) {
-                        std::cerr << "❌ Seek 실패" << std::endl;
-                        break;
+                if (ret != AVERROR_EOF) {
+                    print_error("프레임 읽기 오류", ret);
+                    ok = false;
+                    break;
+                }
+                ok = decode_packet(nullptr, frame, sw_frame, result, start_time, verbose);
+                if (!ok || !enable_loop) {
+                    if (verbose) {
+                        std::cout << "📁 파일 끝 도달" << std::endl;
                     }
-                    
-                    // 시간 제한 체크
-                    auto current_time = std::chrono::high_resolution_clock::now();
-                    if (current_time - start_time > max_duration) {
+                    break;
+                }
+                
+                result.loop_count++;
+                if (verbose) {
+                    std::cout << "🔄 Loop " << result.loop_count << ": 파일 끝 도달, 처음부터 다시 재생 (총 "
+                              << result.frame_count << " 프레임 처리)" << std::endl;
+                }
+                
+                // 시간 제한 체크
+                if (std::chrono::high_resolution_clock::now() - start_time > max_duration) {
+                    if (verbose) {
                         std::cout << "⏰ 시간 제한 도달, 벤치마크 종료" << std::endl;
-                        break;
                     }
-                    
-                    continue;
-                } else if (ret == AVERROR_EOF) {
-                    std::cout << "📁 파일 끝 도달" << std::endl;
-                    break;
-                } else {
-                    print_error("프레임 읽기 오류", ret);
                     break;
                 }
+                
+                // 디코더 상태 초기화 후 파일 시작으로 seek
+                ok = rewind();
+                continue;
             }
             
             if (packet->stream_index == video_stream_index) {
-                ret = avcodec_send_packet(codec_ctx, packet);
-                if (ret < 0) {
-                    print_error("Error sending packet to decoder", ret);
+                ok = decode_packet(packet, frame, sw_frame, result, start_time, verbose);
+            }
+            av_packet_unref(packet);
+        }
+        
+        result.wall_seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+        result.cpu_seconds = cpu_seconds() - start_cpu;
+        result.software_fallback = backend->is_hardware() && result.sw_frame_count > 0;
+        result.ok = ok;
+        
+        if (verbose) {
+            print_result(result, enable_loop);
+        }
+        
+        av_packet_free(&packet);
+        av_frame_free(&frame);
+        av_frame_free(&sw_frame);
+        return result;
+    }
+    
+private:
+    // 컴파일된 모든 장치 유형을 확인: 이 디코더가 지원하고 장치를 열 수 있으면 사용 가능
+    void find_backends() {
+        DecoderBackend software;
+        software.available = true;
+        backends.push_back(software);
+        
+        // 장치가 없는 유형은 열기 실패 로그를 남기므로 확인하는 동안 로그를 끔
+        int log_level = av_log_get_level();
+        av_log_set_level(AV_LOG_QUIET);
+        for (AVHWDeviceType type = av_hwdevice_iterate_types(AV_HWDEVICE_TYPE_NONE); type != AV_HWDEVICE_TYPE_NONE;
+             type = av_hwdevice_iterate_types(type)) {
+            DecoderBackend candidate;
+            candidate.device_type = type;
+            for (int i = 0;; i++) {
+                const AVCodecHWConfig* config = avcodec_get_hw_config(codec, i);
+                if (!config) {
                     break;
                 }
-                
-                while (ret >= 0) {
-                    ret = avcodec_receive_frame(codec_ctx, frame);
-                    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-                        break;
-                    } else if (ret < 0) {
-                        print_error("Error during decoding", ret);
-                        goto cleanup;
-                    }
-                    
-                    frame_count++;
-                    
-                    // 프레임별 성능 측정
-                    auto frame_end_time = std::chrono::high_resolution_clock::now();
-                    auto frame_duration = std::chrono::duration_cast<std::chrono::microseconds>(frame_end_time - frame_start_time);
-                    
-                    // 하드웨어 프레임인지 확인
-                    bool is_hw_frame = (frame->format == AV_PIX_FMT_VIDEOTOOLBOX);
-                    
-                    if (is_hw_frame) {
-                        hw_frame_count++;
-                        std::cout << "[HW] " << std::flush;  // 하드웨어 디코딩 표시
-                        
-                        // 하드웨어 프레임을 소프트웨어 메모리로 전송 데모
-                        if (frame_count % 60 == 0) { // 60프레임마다 데모
-                            if (av_hwframe_transfer_data(sw_frame, frame, 0) == 0) {
-                                const char* sw_format_name = av_get_pix_fmt_name((AVPixelFormat)sw_frame->format);
-                                std::cout << "\n� HW→SW 전송 성공: " << sw_format_name 
-                                         << " (" << sw_frame->width << "x" << sw_frame->height << ")" << std::endl;
-                            }
-                        }
-                    } else {
-                        sw_frame_count++;
-                        std::cout << "[SW] " << std::flush;  // 소프트웨어 디코딩 표시
-                    }
-                    
-                    // 상세한 프레임 정보 (100프레임마다)
-                    if (frame_count % 100 == 0) {
-                        double avg_fps = frame_count * 1000000.0 / std::chrono::duration_cast<std::chrono::microseconds>(frame_end_time - start_time).count();
-                        std::cout << "\n� Frame " << frame_count 
-                                 << " | HW: " << hw_frame_count 
-                                 << " | SW: " << sw_frame_count
-                                 << " | 평균 FPS: " << std::fixed << std::setprecision(1) << avg_fps << std::endl;
-                    }
-                    
-                    av_frame_unref(frame);
-                    av_frame_unref(sw_frame);
-                    frame_start_time = frame_end_time;
+                if ((config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX) && config->device_type == type) {
+                    candidate.hw_pix_fmt = config->pix_fmt;
+                    break;
                 }
             }
-            av_packet_unref(packet);
+            
+            if (candidate.hw_pix_fmt == AV_PIX_FMT_NONE) {
+                candidate.note = std::string("not supported by the ") + codec->name + " decoder";
+            } else if (av_hwdevice_ctx_create(&candidate.device_ctx, type, nullptr, nullptr, 0) < 0) {
+                candidate.note = "no device";
+            } else {
+                candidate.available = true;
+            }
+            backends.push_back(candidate);
+        }
+        av_log_set_level(log_level);
+    }
+    
+    // 디코더를 비우고 입력을 처음으로 되돌림
+    bool rewind() {
+        avcodec_flush_buffers(codec_ctx);
+        if (avformat_seek_file(format_ctx, video_stream_index, 0, 0, 0, AVSEEK_FLAG_FRAME) < 0) {
+            std::cerr << "❌ Seek 실패" << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+    std::string thread_description() const {
+        std::string threads = std::to_string(codec_ctx->thread_count) + " threads, " + thread_type_name(codec_ctx->active_thread_type);
+        return backend->is_hardware() ? "hardware, " + threads : threads;
+    }
+    
+    // 패킷 하나(nullptr = 남은 프레임 비우기)를 디코딩하고 나온 프레임을 모두 처리
+    bool decode_packet(const AVPacket* packet, AVFrame* frame, AVFrame* sw_frame, BenchmarkResult& result,
+                       std::chrono::high_resolution_clock::time_point start_time, bool verbose) {
+        int ret = avcodec_send_packet(codec_ctx, packet);
+        if (ret < 0) {
+            print_error("Error sending packet to decoder", ret);
+            return false;
         }
         
-    cleanup:
-        auto end_time = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-        
-        std::cout << "\n\n=== Final Benchmark Results ===" << std::endl;
-        std::cout << "Total frames processed: " << frame_count << std::endl;
-        std::cout << "Hardware decoding: " << hw_frame_count << " frames" << std::endl;
-        std::cout << "Software decoding: " << sw_frame_count << " frames" << std::endl;
+        while (true) {
+            ret = avcodec_receive_frame(codec_ctx, frame);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+                return true;
+            } else if (ret < 0) {
+                print_error("Error during decoding", ret);
+                return false;
+            }
+            
+            result.frame_count++;
+            
+            if (frame->hw_frames_ctx) {
+                // 하드웨어 프레임은 시스템 메모리로 전송해야 사용할 수 있으므로 매 프레임 전송 시간을 포함
+                result.hw_frame_count++;
+                auto transfer_start = std::chrono::high_resolution_clock::now();
+                ret = av_hwframe_transfer_data(sw_frame, frame, 0);
+                result.transfer_seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - transfer_start).count();
+                if (ret < 0) {
+                    print_error("HW→SW 전송 실패", ret);
+                    av_frame_unref(frame);
+                    return false;
+                }
+                if (verbose && result.hw_frame_count == 1) {
+                    std::cout << "🔄 HW→SW 전송 성공: " << av_get_pix_fmt_name((AVPixelFormat)sw_frame->format)
+                              << " (" << sw_frame->width << "x" << sw_frame->height << ")" << std::endl;
+                }
+                av_frame_unref(sw_frame);
+            } else {
+                result.sw_frame_count++;
+            }
+            
+            // 상세한 프레임 정보 (100프레임마다)
+            if (verbose && result.frame_count % 100 == 0) {
+                double elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+                std::cout << "📊 Frame " << result.frame_count
+                          << " | HW: " << result.hw_frame_count
+                          << " | SW: " << result.sw_frame_count
+                          << " | 평균 FPS: " << std::fixed << std::setprecision(1) << result.frame_count / elapsed << std::endl;
+            }
+            
+            av_frame_unref(frame);
+        }
+    }
+    
+    void print_result(const BenchmarkResult& result, bool enable_loop) {
+        std::cout << "\n=== Final Benchmark Results ===" << std::endl;
+        std::cout << "Backend: " << result.backend << " (" << result.threads << ")" << std::endl;
+        std::cout << "Total frames processed: " << result.frame_count << std::endl;
+        std::cout << "Hardware decoding: " << result.hw_frame_count << " frames" << std::endl;
+        std::cout << "Software decoding: " << result.sw_frame_count << " frames" << std::endl;
+        if (result.software_fallback) {
+            std::cout << "[WARN] " << result.backend << " fell back to software decoding (" << result.threads << ")" << std::endl;
+        }
         if (enable_loop) {
-            std::cout << "Completed loops: " << loop_count << " times" << std::endl;
+            std::cout << "Completed loops: " << result.loop_count << " times" << std::endl;
         }
-        std::cout << "Total time: " << duration.count() << " ms" << std::endl;
-        if (frame_count > 0 && duration.count() > 0) {
-            double fps = (frame_count * 1000.0) / duration.count();
-            double hw_percentage = (double)hw_frame_count / frame_count * 100.0;
+        std::cout << "Total time: " << static_cast<int64_t>(result.wall_seconds * 1000) << " ms" << std::endl;
+        if (result.frame_count > 0 && result.wall_seconds > 0) {
+            double fps = result.frame_count / result.wall_seconds;
+            double hw_percentage = (double)result.hw_frame_count / result.frame_count * 100.0;
             std::cout << "Average decoding speed: " << std::fixed << std::setprecision(2) << fps << " FPS" << std::endl;
+            std::cout << "CPU time: " << std::setprecision(2) << result.cpu_seconds << " s ("
+                      << std::setprecision(1) << result.cpu_seconds / result.wall_seconds << " cores)" << std::endl;
+            if (result.hw_frame_count > 0) {
+                std::cout << "HW→SW transfer: " << std::setprecision(3)
+                          << result.transfer_seconds * 1000.0 / result.hw_frame_count << " ms/frame" << std::endl;
+            }
             std::cout << "Hardware acceleration ratio: " << std::fixed << std::setprecision(1) << hw_percentage << "%" << std::endl;
         }
         std::cout << "=========================================" << std::endl;
-        
-        av_packet_free(&packet);
-        av_frame_free(&frame);
-        av_frame_free(&sw_frame);
     }
     
-private:
     void cleanup() {
         if (codec_ctx) {
             avcodec_free_context(&codec_ctx);
@@ -308,8 +429,8 @@ private:
         if (format_ctx) {
             avformat_close_input(&format_ctx);
         }
-        if (hw_device_ctx) {
-            av_buffer_unref(&hw_device_ctx);
+        for (DecoderBackend& candidate : backends) {
+            av_buffer_unref(&candidate.device_ctx);
         }
     }
     
@@ -320,41 +441,127 @@ private:
     }
 };
 
+// 사용 가능한 모든 백엔드로 같은 입력을 디코딩해 비교
+bool benchmark_backends(HardwareAcceleratedDecoder& decoder, const DecoderThreading& threading, bool enable_loop) {
+    std::vector<BenchmarkResult> results;
+    for (const DecoderBackend& candidate : decoder.get_backends()) {
+        if (!candidate.available) {
+            continue;
+        }
+        std::cout << "\n▶ " << candidate.name() << std::endl;
+        if (!decoder.open_decoder(candidate, threading)) {
+            return false;
+        }
+        results.push_back(decoder.benchmark_decoding(enable_loop, false));
+    }
+    
+    std::cout << "\n=== Backend Comparison ===" << std::endl;
+    std::cout << std::left << std::setw(14) << "Backend" << std::setw(30) << "Threads" << std::right << std::setw(8) << "Frames"
+              << std::setw(10) << "FPS" << std::setw(9) << "CPU s" << std::setw(7) << "Cores" << std::setw(14) << "HW→SW ms" << std::endl;
+    for (const BenchmarkResult& result : results) {
+        std::cout << std::left << std::setw(14) << result.backend << std::setw(30) << result.threads;
+        if (!result.ok || result.frame_count == 0 || result.wall_seconds <= 0) {
+            std::cout << "failed" << std::endl;
+            continue;
+        }
+        std::cout << std::right << std::setw(8) << result.frame_count << std::fixed << std::setprecision(1)
+                  << std::setw(10) << result.frame_count / result.wall_seconds << std::setprecision(2)
+                  << std::setw(9) << result.cpu_seconds << std::setprecision(1) << std::setw(7) << result.cpu_seconds / result.wall_seconds;
+        if (result.hw_frame_count > 0) {
+            std::cout << std::setprecision(3) << std::setw(14) << result.transfer_seconds * 1000.0 / result.hw_frame_count;
+        } else {
+            std::cout << std::setw(14) << "-";
+        }
+        if (result.software_fallback) {
+            std::cout << "  (software fallback)";
+        }
+        std::cout << std::endl;
+    }
+    return true;
+}
+
+void print_usage(const char* program) {
+    std::cout << "[HW] Hardware Accelerated Video Decoder" << std::endl;
+    std::cout << "============================================" << std::endl;
+    std::cout << "사용법: " << program << " [options] <input_file> [loop]" << std::endl;
+    std::cout << "\n옵션:" << std::endl;
+    std::cout << "  --backend <name>     auto (기본: 하드웨어 우선), software, 또는 장치 유형 (vaapi, cuda, videotoolbox ...)" << std::endl;
+    std::cout << "  --list-backends      장치 유형별 사용 가능 여부 출력" << std::endl;
+    std::cout << "  --bench              사용 가능한 모든 백엔드로 디코딩해 비교" << std::endl;
+    std::cout << "  --threads <n>        디코더 스레드 수 (기본: 0 = CPU 코어 수)" << std::endl;
+    std::cout << "  --thread-type <t>    frame, slice, auto (기본)" << std::endl;
+    std::cout << "\n예제:" << std::endl;
+    std::cout << "  " << program << " media/samples/hevc_sample.mp4        # 단일 재생" << std::endl;
+    std::cout << "  " << program << " media/samples/h264_sample.mp4 loop   # 루프 재생 (10초)" << std::endl;
+    std::cout << "  " << program << " --bench media/samples/h264_sample.mp4 # 백엔드 비교" << std::endl;
+    std::cout << "\n지원 코덱:" << std::endl;
+    std::cout << "  [HW]  디코더와 장치가 지원하는 코덱 (--list-backends로 확인)" << std::endl;
+    std::cout << "  💻 기타 모든 코덱 (멀티스레드 소프트웨어 디코딩)" << std::endl;
+}
+
 int main(int argc, char* argv[]) {
-    if (argc < 2 || argc > 3) {
-        std::cout << "[Apple] M1 Mac Hardware Accelerated Video Decoder" << std::endl;
-        std::cout << "============================================" << std::endl;
-        std::cout << "사용법: " << argv[0] << " <input_file> [loop]" << std::endl;
-        std::cout << "\n예제:" << std::endl;
-        std::cout << "  " << argv[0] << " media/samples/hevc_sample.mp4        # 단일 재생" << std::endl;
-        std::cout << "  " << argv[0] << " media/samples/h264_sample.mp4 loop   # 루프 재생 (10초)" << std::endl;
-        std::cout << "\n지원 코덱:" << std::endl;
-        std::cout << "  [HW]  H.264, HEVC (VideoToolbox hardware acceleration)" << std::endl;
-        std::cout << "  💻 기타 모든 코덱 (소프트웨어 디코딩)" << std::endl;
+    std::vector<const char*> positional;
+    std::string backend_name = "auto";
+    bool list_backends = false;
+    bool bench = false;
+    DecoderThreading threading;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--backend" && i + 1 < argc) {
+            backend_name = argv[++i];
+        } else if (arg == "--list-backends") {
+            list_backends = true;
+        } else if (arg == "--bench") {
+            bench = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threading.thread_count = std::atoi(argv[++i]);
+            if (threading.thread_count < 0) {
+                std::cerr << "--threads must be 0 (auto) or positive" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--thread-type" && i + 1 < argc) {
+            threading.thread_type = argv[++i];
+        } else if (arg.size() > 1 && arg[0] == '-' && arg[1] == '-') {
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+    
+    if (positional.empty() || positional.size() > 2 || (positional.size() == 2 && std::string(positional[1]) != "loop")) {
+        print_usage(argv[0]);
         return 1;
     }
     
-    bool enable_loop = (argc == 3 && std::string(argv[2]) == "loop");
+    const char* filename = positional[0];
+    bool enable_loop = positional.size() == 2;
     
-    std::cout << "[Apple] M1 Mac Hardware Accelerated Video Decoder" << std::endl;
+    std::cout << "[HW] Hardware Accelerated Video Decoder" << std::endl;
     std::cout << "============================================" << std::endl;
-    std::cout << "파일: " << argv[1] << std::endl;
-    std::cout << "모드: " << (enable_loop ? "루프 재생 (10초)" : "단일 재생") << std::endl;
+    std::cout << "파일: " << filename << std::endl;
+    std::cout << "모드: " << (enable_loop ? "루프 재생 (10초)" : "단일 재생") << (bench ? ", 백엔드 비교" : "") << std::endl;
     std::cout << "----------------------------------------" << std::endl;
     
     HardwareAcceleratedDecoder decoder;
+    if (!decoder.open_file(filename)) {
+        return 1;
+    }
     
-    // Initialize hardware acceleration
-    if (!decoder.initialize_hardware_acceleration()) {
-        std::cerr << "[WARN] Hardware acceleration initialization failed, continuing with software decoding..." << std::endl;
+    if (list_backends) {
+        decoder.print_backends();
+        return 0;
     }
     
-    // Open file and decode
-    if (!decoder.open_file(argv[1])) {
-        return 1;
+    if (bench) {
+        return benchmark_backends(decoder, threading, enable_loop) ? 0 : 1;
     }
     
-    decoder.benchmark_decoding(enable_loop);
+    const DecoderBackend* backend = decoder.select_backend(backend_name);
+    if (!backend || !decoder.open_decoder(*backend, threading)) {
+        return 1;
+    }
     
-    return 0;
+    return decoder.benchmark_decoding(enable_loop).ok ? 0 : 1;
 }
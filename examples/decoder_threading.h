@@ -0,0 +1,62 @@
+// Decoder threading options shared by the decoding tools (--threads, --thread-type)
+// and the process CPU time used to report how many cores they kept busy.
+#ifndef DECODER_THREADING_H
+#define DECODER_THREADING_H
+
+#include <iostream>
+#include <string>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+// Decoder threading selected on the command line
+struct DecoderThreading {
+    int thread_count = 0;               // 0 = one thread per CPU core
+    std::string thread_type = "auto";   // frame, slice or auto
+};
+
+// Apply the threading mode before avcodec_open2. Frame threading decodes
+// several frames at once (one frame of extra delay per thread); slice
+// threading splits each frame and only helps streams encoded with slices.
+inline bool configure_decoder_threads(AVCodecContext* codec_ctx, const DecoderThreading& threading) {
+    codec_ctx->thread_count = threading.thread_count;
+    
+    if (threading.thread_type == "frame") {
+        codec_ctx->thread_type = FF_THREAD_FRAME;
+    } else if (threading.thread_type == "slice") {
+        codec_ctx->thread_type = FF_THREAD_SLICE;
+    } else if (threading.thread_type == "auto") {
+        codec_ctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    } else {
+        std::cerr << "Unknown thread type: " << threading.thread_type << " (use frame, slice or auto)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Threading mode the decoder actually chose (after avcodec_open2)
+inline const char* thread_type_name(int active_thread_type) {
+    if (active_thread_type & FF_THREAD_FRAME) return "frame";
+    if (active_thread_type & FF_THREAD_SLICE) return "slice";
+    return "none";
+}
+
+// User + system CPU time of the whole process, including codec worker threads
+#ifndef _WIN32
+inline double cpu_seconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+#else
+inline double cpu_seconds() {
+    return 0.0;
+}
+#endif
+
+#endif // DECODER_THREADING_H
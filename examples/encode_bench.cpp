@@ -0,0 +1,574 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/avutil.h>
+#include <libavutil/opt.h>
+}
+
+#include "decoder_threading.h"
+#include "encoder_profile.h"
+#include "frame_pool.h"
+#include "pattern_generator.h"
+#include "quality_meter.h"
+
+// Encoder throughput and quality sweep. Every combination of resolution,
+// codec, preset and thread count encodes the same synthetic clip; the packets
+// are then decoded and compared with the regenerated source frames.
+
+static const AVRational bench_frame_rate = {25, 1};
+
+struct BenchOptions {
+    std::vector<std::string> resolutions = {"640x360", "1280x720", "1920x1080"};
+    std::vector<std::string> codecs = {"h264", "hevc", "vp9", "av1"};
+    std::vector<std::string> presets;       // Empty = per-encoder defaults
+    std::vector<int> threads = {0};
+    int frames = 60;
+    TestPattern pattern = TestPattern::ZonePlate;
+    int64_t bitrate = 0;                    // 0 = 0.1 bits per pixel
+    bool quality = true;
+};
+
+struct BenchConfig {
+    std::string codec;          // Name given on the command line
+    const AVCodec* encoder;
+    int width;
+    int height;
+    std::string preset;
+    int threads;
+    int64_t bitrate;
+};
+
+// Plain data so it can be passed back from the benchmark process through a pipe
+struct BenchResult {
+    bool ok;
+    bool has_quality;
+    int frames;
+    int64_t bytes;
+    double wall_seconds;        // Encoding only, pattern generation excluded
+    double cpu_seconds;         // User + system time of all encoder threads
+    int64_t peak_rss_kb;        // -1 when not available
+    double psnr_y;
+    double psnr;
+    double ssim_y;
+    char message[160];
+};
+
+// Codec families map to their default encoder; anything else is an encoder name
+const AVCodec* find_bench_encoder(const std::string& name) {
+    if (name == "h264") return avcodec_find_encoder(AV_CODEC_ID_H264);
+    if (name == "hevc") return avcodec_find_encoder(AV_CODEC_ID_HEVC);
+    if (name == "vp9") return avcodec_find_encoder(AV_CODEC_ID_VP9);
+    if (name == "av1") return avcodec_find_encoder(AV_CODEC_ID_AV1);
+    return avcodec_find_encoder_by_name(name.c_str());
+}
+
+// A fast and a slower speed setting for encoders we know
+std::vector<std::string> default_presets(const AVCodec* encoder) {
+    std::string name = encoder->name;
+    if (name == "libx264" || name == "libx265") return {"veryfast", "medium"};
+    if (name == "libsvtav1") return {"10", "6"};
+    if (name == "libaom-av1") return {"8", "6"};
+    if (name == "libvpx-vp9") return {"8", "4"};
+    if (name == "librav1e") return {"10", "6"};
+    return {""};
+}
+
+// Encoders name their speed knob differently
+const char* preset_option(AVCodecContext* codec_ctx) {
+    for (const char* name : {"preset", "cpu-used", "speed"}) {
+        if (has_encoder_option(codec_ctx, name)) {
+            return name;
+        }
+    }
+    return nullptr;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+#ifndef _WIN32
+int64_t peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;  // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+}
+#else
+int64_t peak_rss_kb() {
+    return -1;
+}
+#endif
+
+void set_message(BenchResult& result, const std::string& message) {
+    snprintf(result.message, sizeof(result.message), "%s", message.c_str());
+}
+
+std::string error_text(int error_code) {
+    char error_buf[AV_ERROR_MAX_STRING_SIZE];
+    av_strerror(error_code, error_buf, AV_ERROR_MAX_STRING_SIZE);
+    return error_buf;
+}
+
+bool drain_encoder(AVCodecContext* codec_ctx, const AVFrame* frame, AVPacket* packet, std::vector<AVPacket*>& packets) {
+    if (avcodec_send_frame(codec_ctx, frame) < 0) {
+        return false;
+    }
+    while (true) {
+        int ret = avcodec_receive_packet(codec_ctx, packet);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            return true;
+        } else if (ret < 0) {
+            return false;
+        }
+        AVPacket* kept = av_packet_alloc();
+        if (!kept) {
+            return false;
+        }
+        av_packet_move_ref(kept, packet);
+        packets.push_back(kept);
+    }
+}
+
+// Decode the packets and score every frame against the regenerated source
+bool measure_quality(const BenchConfig& config, const BenchOptions& options, const AVCodecContext* encoder_ctx,
+                     const std::vector<AVPacket*>& packets, BenchResult& result) {
+    const AVCodec* decoder = avcodec_find_decoder(encoder_ctx->codec_id);
+    if (!decoder) {
+        set_message(result, "no decoder for quality");
+        return false;
+    }
+    
+    AVCodecContext* decoder_ctx = avcodec_alloc_context3(decoder);
+    AVCodecParameters* params = avcodec_parameters_alloc();
+    AVFrame* decoded = av_frame_alloc();
+    AVFrame* source = av_frame_alloc();
+    bool ok = decoder_ctx && params && decoded && source;
+    if (ok) {
+        ok = avcodec_parameters_from_context(params, encoder_ctx) >= 0 &&
+             avcodec_parameters_to_context(decoder_ctx, params) >= 0 &&
+             avcodec_open2(decoder_ctx, decoder, nullptr) >= 0;
+    }
+    if (ok) {
+        source->format = AV_PIX_FMT_YUV420P;
+        source->width = config.width;
+        source->height = config.height;
+        ok = av_frame_get_buffer(source, 0) >= 0;
+    }
+    if (!ok) {
+        set_message(result, "could not open decoder for quality");
+    }
+    
+    PatternGenerator generator(options.pattern, config.width, config.height);
+    QualityMeter meter;
+    int64_t next_frame = 0;
+    
+    auto score_frames = [&]() {
+        while (avcodec_receive_frame(decoder_ctx, decoded) >= 0) {
+            if (decoded->format != AV_PIX_FMT_YUV420P || decoded->width != config.width || decoded->height != config.height) {
+                set_message(result, "decoder output is not the source format");
+                ok = false;
+                return;
+            }
+            int64_t index = decoded->pts != AV_NOPTS_VALUE ? decoded->pts : next_frame;
+            next_frame = index + 1;
+            generator.fill(source, index);
+            meter.measure(source, decoded);
+            av_frame_unref(decoded);
+        }
+    };
+    
+    for (size_t i = 0; ok && i < packets.size(); i++) {
+        if (avcodec_send_packet(decoder_ctx, packets[i]) < 0) {
+            set_message(result, "decoding failed");
+            ok = false;
+            break;
+        }
+        score_frames();
+    }
+    if (ok) {
+        avcodec_send_packet(decoder_ctx, nullptr);
+        score_frames();
+    }
+    
+    if (ok && meter.frame_count() != result.frames) {
+        set_message(result, "decoded " + std::to_string(meter.frame_count()) + " of " + std::to_string(result.frames) + " frames");
+        ok = false;
+    }
+    if (ok) {
+        QualityScores scores = meter.average();
+        result.psnr_y = scores.psnr_y;
+        result.psnr = scores.psnr;
+        result.ssim_y = scores.ssim_y;
+    }
+    
+    av_frame_free(&source);
+    av_frame_free(&decoded);
+    avcodec_parameters_free(&params);
+    avcodec_free_context(&decoder_ctx);
+    return ok;
+}
+
+void run_benchmark(const BenchConfig& config, const BenchOptions& options, BenchResult& result) {
+    AVCodecContext* codec_ctx = avcodec_alloc_context3(config.encoder);
+    if (!codec_ctx) {
+        set_message(result, "could not allocate codec context");
+        return;
+    }
+    
+    // GOP of two seconds, rate control towards the configured bitrate
+    EncoderProfile profile;
+    profile.name = config.codec;
+    profile.codec = config.encoder->name;
+    profile.bitrate = config.bitrate;
+    profile.gop = 50;
+    profile.b_frames = 2;
+    profile.threads = config.threads;
+    if (!config.preset.empty()) {
+        const char* option = preset_option(codec_ctx);
+        if (!option) {
+            set_message(result, "encoder has no preset option");
+            avcodec_free_context(&codec_ctx);
+            return;
+        }
+        if (strcmp(option, "preset") == 0) {
+            profile.preset = config.preset;
+        } else {
+            profile.codec_options.emplace_back(option, config.preset);
+        }
+    }
+    
+    codec_ctx->width = config.width;
+    codec_ctx->height = config.height;
+    codec_ctx->time_base = av_inv_q(bench_frame_rate);
+    codec_ctx->framerate = bench_frame_rate;
+    codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    
+    AVDictionary* dict = nullptr;
+    configure_encoder(codec_ctx, profile, &dict);
+    int ret = avcodec_open2(codec_ctx, config.encoder, &dict);
+    bool options_ok = ret >= 0 && check_unused_encoder_options(dict, profile, config.encoder->name);
+    av_dict_free(&dict);
+    if (ret < 0 || !options_ok) {
+        set_message(result, ret < 0 ? "could not open encoder: " + error_text(ret) : "unsupported encoder option");
+        avcodec_free_context(&codec_ctx);
+        return;
+    }
+    
+    FramePool frame_pool;
+    AVFrame* frame = av_frame_alloc();
+    AVPacket* packet = av_packet_alloc();
+    int reserve = std::max(codec_ctx->delay, codec_ctx->max_b_frames) + 2;
+    std::vector<AVPacket*> packets;
+    bool ok = frame && packet && frame_pool.init(codec_ctx->pix_fmt, config.width, config.height, reserve);
+    if (!ok) {
+        set_message(result, "could not allocate frames");
+    }
+    
+    // Encode; pattern generation is timed separately and left out of the numbers
+    PatternGenerator generator(options.pattern, config.width, config.height);
+    double generate_time = 0.0;
+    double cpu_start = cpu_seconds();
+    auto start_time = std::chrono::steady_clock::now();
+    
+    for (int i = 0; ok && i < options.frames; i++) {
+        if (!frame_pool.get(frame)) {
+            set_message(result, "could not get frame buffer");
+            ok = false;
+            break;
+        }
+        auto generate_start = std::chrono::steady_clock::now();
+        generator.fill(frame, i);
+        generate_time += seconds_since(generate_start);
+        frame->pts = i;
+        if (!drain_encoder(codec_ctx, frame, packet, packets)) {
+            set_message(result, "encoding failed");
+            ok = false;
+        }
+    }
+    if (ok && !drain_encoder(codec_ctx, nullptr, packet, packets)) {
+        set_message(result, "encoding failed");
+        ok = false;
+    }
+    
+    result.wall_seconds = seconds_since(start_time) - generate_time;
+    result.cpu_seconds = cpu_seconds() - cpu_start - generate_time;
+    result.peak_rss_kb = peak_rss_kb();
+    result.frames = options.frames;
+    for (const AVPacket* encoded : packets) {
+        result.bytes += encoded->size;
+    }
+    result.ok = ok;
+    
+    if (ok && options.quality) {
+        result.has_quality = measure_quality(config, options, codec_ctx, packets, result);
+    }
+    
+    for (AVPacket*& encoded : packets) {
+        av_packet_free(&encoded);
+    }
+    av_packet_free(&packet);
+    av_frame_free(&frame);
+    avcodec_free_context(&codec_ctx);
+}
+
+// Each configuration runs in its own process so CPU time and peak RSS belong
+// to that encoder alone, and a crashing encoder does not end the sweep
+BenchResult run_isolated(const BenchConfig& config, const BenchOptions& options) {
+    BenchResult result = {};
+#ifndef _WIN32
+    int fds[2];
+    if (pipe(fds) != 0) {
+        set_message(result, "pipe failed");
+        return result;
+    }
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        run_benchmark(config, options, result);
+        ssize_t written = write(fds[1], &result, sizeof(result));
+        _exit(written == sizeof(result) ? 0 : 1);
+    }
+    close(fds[1]);
+    if (pid < 0) {
+        close(fds[0]);
+        set_message(result, "fork failed");
+        return result;
+    }
+    
+    size_t received = 0;
+    while (received < sizeof(result)) {
+        ssize_t n = read(fds[0], reinterpret_cast<char*>(&result) + received, sizeof(result) - received);
+        if (n <= 0) {
+            break;
+        }
+        received += n;
+    }
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (received != sizeof(result)) {
+        result = {};
+        set_message(result, WIFSIGNALED(status) ? "encoder crashed (signal " + std::to_string(WTERMSIG(status)) + ")"
+                                                 : std::string("benchmark process failed"));
+    }
+#else
+    run_benchmark(config, options, result);
+#endif
+    return result;
+}
+
+std::vector<std::string> split_list(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// CSV fields here never contain quotes; quote the free-text ones for commas
+std::string csv_text(const std::string& text) {
+    return "\"" + text + "\"";
+}
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <output.csv>" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --resolutions <list>   e.g. 640x360,1920x1080 (default: 640x360,1280x720,1920x1080)" << std::endl;
+    std::cerr << "  --codecs <list>        h264, hevc, vp9, av1 or encoder names (default: h264,hevc,vp9,av1)" << std::endl;
+    std::cerr << "  --presets <list>       Presets (or cpu-used values) for every codec (default: per encoder)" << std::endl;
+    std::cerr << "  --threads <list>       Encoder thread counts, 0 = auto (default: 0)" << std::endl;
+    std::cerr << "  --frames <n>           Frames per run (default: 60)" << std::endl;
+    std::cerr << "  --pattern <name>       gradient, bars, noise, zoneplate (default: zoneplate)" << std::endl;
+    std::cerr << "  --bitrate <rate>       Target bitrate, e.g. 4M (default: 0.1 bits per pixel)" << std::endl;
+    std::cerr << "  --no-quality           Skip decoding and PSNR/SSIM" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    std::vector<const char*> positional;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--resolutions" && i + 1 < argc) {
+            options.resolutions = split_list(argv[++i]);
+        } else if (arg == "--codecs" && i + 1 < argc) {
+            options.codecs = split_list(argv[++i]);
+        } else if (arg == "--presets" && i + 1 < argc) {
+            options.presets = split_list(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.threads.clear();
+            for (const std::string& item : split_list(argv[++i])) {
+                options.threads.push_back(std::atoi(item.c_str()));
+            }
+        } else if (arg == "--frames" && i + 1 < argc) {
+            options.frames = std::atoi(argv[++i]);
+        } else if (arg == "--pattern" && i + 1 < argc) {
+            if (!parse_test_pattern(argv[++i], options.pattern)) {
+                std::cerr << "Unknown pattern: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--bitrate" && i + 1 < argc) {
+            if (!parse_bitrate(argv[++i], options.bitrate)) {
+                std::cerr << "Invalid bitrate: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--no-quality") {
+            options.quality = false;
+        } else if (arg.size() > 1 && arg[0] == '-' && arg[1] == '-') {
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+    
+    if (positional.size() != 1 || options.frames <= 0 || options.threads.empty()) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    for (int threads : options.threads) {
+        if (threads < 0) {
+            std::cerr << "Thread counts must not be negative" << std::endl;
+            return 1;
+        }
+    }
+    
+    // Unavailable encoders are reported and skipped
+    std::vector<std::pair<std::string, const AVCodec*>> encoders;
+    for (const std::string& codec : options.codecs) {
+        const AVCodec* encoder = find_bench_encoder(codec);
+        if (encoder) {
+            encoders.emplace_back(codec, encoder);
+        } else {
+            std::cerr << "Skipping " << codec << ": no encoder available" << std::endl;
+        }
+    }
+    
+    // Expand the sweep
+    std::vector<BenchConfig> configs;
+    for (const std::string& resolution : options.resolutions) {
+        int width = 0;
+        int height = 0;
+        if (sscanf(resolution.c_str(), "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+            std::cerr << "Invalid resolution: " << resolution << std::endl;
+            return 1;
+        }
+        for (const auto& [codec, encoder] : encoders) {
+            int64_t bitrate = options.bitrate > 0 ? options.bitrate
+                : static_cast<int64_t>(0.1 * width * height * av_q2d(bench_frame_rate));
+            std::vector<std::string> presets = options.presets.empty() ? default_presets(encoder) : options.presets;
+            for (const std::string& preset : presets) {
+                for (int threads : options.threads) {
+                    configs.push_back({codec, encoder, width, height, preset, threads, bitrate});
+                }
+            }
+        }
+    }
+    if (configs.empty()) {
+        std::cerr << "Nothing to benchmark" << std::endl;
+        return 1;
+    }
+    
+    std::ofstream csv(positional[0]);
+    if (!csv) {
+        std::cerr << "Could not open " << positional[0] << std::endl;
+        return 1;
+    }
+    csv << "codec,encoder,width,height,preset,threads,frames,target_kbps,actual_kbps,bitrate_error_pct,"
+           "encode_fps,wall_s,cpu_s,cpu_cores,peak_rss_mb,psnr_y,psnr,ssim_y,pattern,status" << std::endl;
+    
+    std::cout << "Running " << configs.size() << " configurations, " << options.frames << " frames each ("
+              << test_pattern_name(options.pattern) << " pattern, " << av_version_info() << ")" << std::endl;
+    std::cout << std::left << std::setw(12) << "encoder" << std::setw(11) << "size" << std::setw(10) << "preset"
+              << std::setw(8) << "threads" << std::right << std::setw(9) << "fps" << std::setw(10) << "kb/s"
+              << std::setw(8) << "err%" << std::setw(8) << "cores" << std::setw(9) << "RSS MB"
+              << std::setw(8) << "PSNR" << std::setw(8) << "SSIM" << std::endl;
+    
+    int failures = 0;
+    for (size_t i = 0; i < configs.size(); i++) {
+        const BenchConfig& config = configs[i];
+        BenchResult result = run_isolated(config, options);
+        
+        double duration = result.frames / av_q2d(bench_frame_rate);
+        double actual_kbps = duration > 0 ? result.bytes * 8 / duration / 1000 : 0.0;
+        double target_kbps = config.bitrate / 1000.0;
+        double error_pct = target_kbps > 0 ? 100.0 * (actual_kbps - target_kbps) / target_kbps : 0.0;
+        double fps = result.wall_seconds > 0 ? result.frames / result.wall_seconds : 0.0;
+        double cores = result.wall_seconds > 0 ? result.cpu_seconds / result.wall_seconds : 0.0;
+        double rss_mb = result.peak_rss_kb >= 0 ? result.peak_rss_kb / 1024.0 : 0.0;
+        std::string size = std::to_string(config.width) + "x" + std::to_string(config.height);
+        std::string status = result.ok ? (result.message[0] ? std::string("ok (") + result.message + ")" : "ok") : result.message;
+        
+        std::cout << std::left << std::setw(12) << config.encoder->name << std::setw(11) << size
+                  << std::setw(10) << (config.preset.empty() ? "-" : config.preset) << std::setw(8) << config.threads;
+        if (result.ok) {
+            std::cout << std::right << std::fixed << std::setprecision(1) << std::setw(9) << fps
+                      << std::setw(10) << actual_kbps << std::setw(8) << error_pct << std::setw(8) << cores
+                      << std::setw(9) << rss_mb;
+            if (result.has_quality) {
+                std::cout << std::setprecision(2) << std::setw(8) << result.psnr_y << std::setprecision(4) << std::setw(8) << result.ssim_y;
+            }
+            if (!result.has_quality && result.message[0]) {
+                std::cout << "  " << result.message;
+            }
+            std::cout << std::endl;
+        } else {
+            std::cout << "failed: " << result.message << std::endl;
+            failures++;
+        }
+        
+        // Empty fields for values that were not measured
+        csv << config.codec << "," << config.encoder->name << "," << config.width << "," << config.height << ","
+            << csv_text(config.preset) << "," << config.threads << "," << options.frames << ","
+            << std::fixed << std::setprecision(1) << target_kbps << ",";
+        if (result.ok) {
+            csv << actual_kbps << "," << std::setprecision(2) << error_pct << "," << fps << ","
+                << std::setprecision(3) << result.wall_seconds << ",";
+            if (result.peak_rss_kb >= 0) {
+                csv << result.cpu_seconds << "," << std::setprecision(2) << cores << "," << std::setprecision(1) << rss_mb << ",";
+            } else {
+                csv << ",,,";
+            }
+            if (result.has_quality) {
+                csv << std::setprecision(3) << result.psnr_y << "," << result.psnr << "," << std::setprecision(5) << result.ssim_y << ",";
+            } else {
+                csv << ",,,";
+            }
+        } else {
+            csv << ",,,,,,,,,,";
+        }
+        csv << test_pattern_name(options.pattern) << "," << csv_text(status) << std::endl;
+    }
+    
+    std::cout << "Results written to " << positional[0];
+    if (failures > 0) {
+        std::cout << " (" << failures << " of " << configs.size() << " configurations failed)";
+    }
+    std::cout << std::endl;
+    return 0;
+}
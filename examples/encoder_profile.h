@@ -0,0 +1,365 @@
+// Encoding profiles: rate control, preset/tune, GOP structure and threading
+// for libavcodec video encoders, loaded from a simple config file.
+//
+// Config format (one profile per section, '#' starts a comment):
+//
+//   [x264-fast]
+//   codec = libx264
+//   rate_control = crf      # crf, cbr or vbr
+//   crf = 23
+//   preset = veryfast
+//   gop = 250
+//   threads = 0             # 0 = one per CPU core
+//   opt.x264-params = aq-mode=2
+//
+// Values are checked when the file is loaded; settings the chosen encoder
+// does not understand are reported when the encoder is opened.
+#ifndef ENCODER_PROFILE_H
+#define ENCODER_PROFILE_H
+
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/dict.h>
+#include <libavutil/opt.h>
+}
+
+enum class RateControl { Crf, Cbr, Vbr };
+
+struct EncoderProfile {
+    std::string name = "default";
+    std::string codec;                  // Encoder name (empty = default H.264 encoder)
+    RateControl rate_control = RateControl::Vbr;
+    int crf = 23;
+    int64_t bitrate = 400000;           // Target bits/s for CBR and VBR
+    int64_t max_bitrate = 0;            // VBR peak (0 = unconstrained)
+    int64_t buffer_size = 0;            // VBV buffer in bits (0 = one second of max rate)
+    std::string preset;
+    std::string tune;
+    int gop = 10;
+    int b_frames = 1;
+    int threads = 0;                    // 0 = one per CPU core
+    std::string thread_type = "auto";   // frame, slice or auto
+    int lookahead = -1;                 // Rate control lookahead frames (-1 = encoder default)
+    std::vector<std::pair<std::string, std::string>> codec_options;    // opt.<name> = value
+};
+
+inline const char* rate_control_name(RateControl mode) {
+    switch (mode) {
+        case RateControl::Crf: return "crf";
+        case RateControl::Cbr: return "cbr";
+        default: return "vbr";
+    }
+}
+
+// "2500000", "2500k" or "2.5M". Capped at INT_MAX because rc_buffer_size is
+// an int and falls back to the bitrate when no buffer size is given.
+inline bool parse_bitrate(const std::string& text, int64_t& bits) {
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    if (end == text.c_str()) {
+        return false;
+    }
+    std::string suffix(end);
+    if (suffix == "k" || suffix == "K") {
+        value *= 1000;
+    } else if (suffix == "m" || suffix == "M") {
+        value *= 1000000;
+    } else if (!suffix.empty()) {
+        return false;
+    }
+    if (!std::isfinite(value) || value < 1 || value > INT_MAX) {
+        return false;
+    }
+    bits = (int64_t)value;
+    return true;
+}
+
+inline bool parse_profile_int(const std::string& text, int min_value, int max_value, int& value) {
+    char* end = nullptr;
+    long parsed = std::strtol(text.c_str(), &end, 10);
+    if (end == text.c_str() || *end != '\0' || parsed < min_value || parsed > max_value) {
+        return false;
+    }
+    value = (int)parsed;
+    return true;
+}
+
+inline std::string trim_profile_text(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    return text.substr(begin, text.find_last_not_of(" \t\r") - begin + 1);
+}
+
+// Apply one "key = value" line to a profile; returns an error message or ""
+inline std::string set_profile_value(EncoderProfile& profile, const std::string& key, const std::string& value) {
+    if (key == "codec") {
+        profile.codec = value;
+    } else if (key == "rate_control") {
+        if (value == "crf") {
+            profile.rate_control = RateControl::Crf;
+        } else if (value == "cbr") {
+            profile.rate_control = RateControl::Cbr;
+        } else if (value == "vbr") {
+            profile.rate_control = RateControl::Vbr;
+        } else {
+            return "rate_control must be crf, cbr or vbr";
+        }
+    } else if (key == "crf") {
+        if (!parse_profile_int(value, 0, 63, profile.crf)) {
+            return "crf must be an integer between 0 and 63";
+        }
+    } else if (key == "bitrate" || key == "max_bitrate" || key == "buffer_size") {
+        int64_t& target = key == "bitrate" ? profile.bitrate :
+                          key == "max_bitrate" ? profile.max_bitrate : profile.buffer_size;
+        if (!parse_bitrate(value, target)) {
+            return key + " must be a positive number of bits up to 2147M, optionally with a k or M suffix";
+        }
+    } else if (key == "preset") {
+        profile.preset = value;
+    } else if (key == "tune") {
+        profile.tune = value;
+    } else if (key == "gop") {
+        if (!parse_profile_int(value, 1, 100000, profile.gop)) {
+            return "gop must be a positive number of frames";
+        }
+    } else if (key == "b_frames") {
+        if (!parse_profile_int(value, 0, 16, profile.b_frames)) {
+            return "b_frames must be between 0 and 16";
+        }
+    } else if (key == "threads") {
+        if (!parse_profile_int(value, 0, 256, profile.threads)) {
+            return "threads must be between 0 (auto) and 256";
+        }
+    } else if (key == "thread_type") {
+        if (value != "frame" && value != "slice" && value != "auto") {
+            return "thread_type must be frame, slice or auto";
+        }
+        profile.thread_type = value;
+    } else if (key == "lookahead") {
+        if (!parse_profile_int(value, 0, 250, profile.lookahead)) {
+            return "lookahead must be between 0 and 250 frames";
+        }
+    } else if (key.compare(0, 4, "opt.") == 0 && key.size() > 4) {
+        profile.codec_options.emplace_back(key.substr(4), value);
+    } else {
+        return "unknown setting '" + key + "'";
+    }
+    return "";
+}
+
+// Settings that only make sense together, checked once a profile is complete
+inline std::string check_profile(const EncoderProfile& profile) {
+    if (profile.rate_control == RateControl::Vbr && profile.max_bitrate > 0 &&
+        profile.max_bitrate < profile.bitrate) {
+        return "max_bitrate is below bitrate";
+    }
+    if (profile.b_frames >= profile.gop) {
+        return "b_frames must be smaller than gop";
+    }
+    // crf is loaded as 0-63 (VP9/AV1 scale); x264 and x265 stop at 51
+    if (profile.rate_control == RateControl::Crf && profile.crf > 51 &&
+        (profile.codec == "libx264" || profile.codec == "libx264rgb" || profile.codec == "libx265")) {
+        return "crf must be between 0 and 51 for " + profile.codec;
+    }
+    return "";
+}
+
+// Load every profile in the file. Errors are printed as path:line: message
+// and make the whole file invalid.
+inline bool load_encoder_profiles(const std::string& path, std::vector<EncoderProfile>& profiles) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Could not open profile file " << path << std::endl;
+        return false;
+    }
+    
+    bool ok = true;
+    std::string line;
+    int line_number = 0;
+    std::vector<int> section_lines;
+    auto error = [&](int at, const std::string& message) {
+        std::cerr << path << ":" << at << ": " << message << std::endl;
+        ok = false;
+    };
+    
+    while (std::getline(in, line)) {
+        line_number++;
+        line = trim_profile_text(line.substr(0, line.find('#')));
+        if (line.empty()) {
+            continue;
+        }
+        
+        if (line.front() == '[') {
+            std::string name = line.back() == ']' ? trim_profile_text(line.substr(1, line.size() - 2)) : "";
+            if (name.empty()) {
+                error(line_number, "expected [profile-name]");
+                continue;
+            }
+            for (const EncoderProfile& existing : profiles) {
+                if (existing.name == name) {
+                    error(line_number, "duplicate profile '" + name + "'");
+                }
+            }
+            profiles.emplace_back();
+            profiles.back().name = name;
+            section_lines.push_back(line_number);
+            continue;
+        }
+        
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            error(line_number, "expected key = value");
+            continue;
+        }
+        if (profiles.empty()) {
+            error(line_number, "setting outside of a [profile] section");
+            continue;
+        }
+        std::string key = trim_profile_text(line.substr(0, equals));
+        std::string value = trim_profile_text(line.substr(equals + 1));
+        if (value.empty()) {
+            error(line_number, "missing value for '" + key + "'");
+            continue;
+        }
+        std::string message = set_profile_value(profiles.back(), key, value);
+        if (!message.empty()) {
+            error(line_number, message);
+        }
+    }
+    
+    for (size_t i = 0; i < profiles.size(); i++) {
+        std::string message = check_profile(profiles[i]);
+        if (!message.empty()) {
+            error(section_lines[i], "profile '" + profiles[i].name + "': " + message);
+        }
+    }
+    if (ok && profiles.empty()) {
+        std::cerr << path << ": no profiles defined" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+inline const EncoderProfile* find_encoder_profile(const std::vector<EncoderProfile>& profiles, const std::string& name) {
+    for (const EncoderProfile& profile : profiles) {
+        if (profile.name == name) {
+            return &profile;
+        }
+    }
+    return nullptr;
+}
+
+inline const AVCodec* find_profile_encoder(const EncoderProfile& profile) {
+    if (profile.codec.empty()) {
+        return avcodec_find_encoder(AV_CODEC_ID_H264);
+    }
+    return avcodec_find_encoder_by_name(profile.codec.c_str());
+}
+
+inline bool has_encoder_option(AVCodecContext* codec_ctx, const char* name) {
+    return codec_ctx->priv_data && av_opt_find(codec_ctx->priv_data, name, nullptr, 0, 0);
+}
+
+// Set the codec context fields and collect the encoder private options in
+// `options` for avcodec_open2. Call before opening the encoder.
+inline void configure_encoder(AVCodecContext* codec_ctx, const EncoderProfile& profile, AVDictionary** options) {
+    codec_ctx->gop_size = profile.gop;
+    codec_ctx->max_b_frames = profile.b_frames;
+    codec_ctx->thread_count = profile.threads;
+    if (profile.thread_type == "frame") {
+        codec_ctx->thread_type = FF_THREAD_FRAME;
+    } else if (profile.thread_type == "slice") {
+        codec_ctx->thread_type = FF_THREAD_SLICE;
+    } else {
+        codec_ctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    }
+    
+    switch (profile.rate_control) {
+        case RateControl::Crf:
+            av_dict_set_int(options, "crf", profile.crf, 0);
+            break;
+        case RateControl::Cbr:
+            codec_ctx->bit_rate = profile.bitrate;
+            codec_ctx->rc_min_rate = profile.bitrate;
+            codec_ctx->rc_max_rate = profile.bitrate;
+            codec_ctx->rc_buffer_size = (int)(profile.buffer_size > 0 ? profile.buffer_size : profile.bitrate);
+            // Encoders that need to be told to pad to a constant rate
+            if (has_encoder_option(codec_ctx, "nal-hrd")) {
+                av_dict_set(options, "nal-hrd", "cbr", 0);
+            }
+            if (has_encoder_option(codec_ctx, "rc_mode")) {
+                av_dict_set(options, "rc_mode", "bitrate", 0);
+            }
+            break;
+        case RateControl::Vbr:
+            codec_ctx->bit_rate = profile.bitrate;
+            if (profile.max_bitrate > 0) {
+                codec_ctx->rc_max_rate = profile.max_bitrate;
+                codec_ctx->rc_buffer_size = (int)(profile.buffer_size > 0 ? profile.buffer_size : profile.max_bitrate);
+            }
+            break;
+    }
+    
+    if (!profile.preset.empty()) {
+        av_dict_set(options, "preset", profile.preset.c_str(), 0);
+    }
+    if (!profile.tune.empty()) {
+        av_dict_set(options, "tune", profile.tune.c_str(), 0);
+    }
+    if (profile.lookahead >= 0) {
+        av_dict_set_int(options, "rc-lookahead", profile.lookahead, 0);
+    }
+    for (const auto& option : profile.codec_options) {
+        av_dict_set(options, option.first.c_str(), option.second.c_str(), 0);
+    }
+}
+
+// avcodec_open2 leaves the options it did not use in the dictionary: the
+// profile asked for something this encoder cannot do
+inline bool check_unused_encoder_options(const AVDictionary* options, const EncoderProfile& profile, const char* encoder_name) {
+    const AVDictionaryEntry* entry = nullptr;
+    bool ok = true;
+    while ((entry = av_dict_iterate(options, entry))) {
+        std::cerr << "Profile '" << profile.name << "': " << encoder_name
+                  << " does not support " << entry->key << " = " << entry->value << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+inline void print_encoder_profile(const EncoderProfile& profile, std::ostream& out = std::cout) {
+    out << profile.name << ": " << (profile.codec.empty() ? "h264" : profile.codec)
+        << ", " << rate_control_name(profile.rate_control);
+    if (profile.rate_control == RateControl::Crf) {
+        out << " " << profile.crf;
+    } else {
+        out << " " << profile.bitrate / 1000 << " kb/s";
+        if (profile.rate_control == RateControl::Vbr && profile.max_bitrate > 0) {
+            out << " (max " << profile.max_bitrate / 1000 << " kb/s)";
+        }
+    }
+    if (!profile.preset.empty()) out << ", preset " << profile.preset;
+    if (!profile.tune.empty()) out << ", tune " << profile.tune;
+    out << ", gop " << profile.gop << ", b-frames " << profile.b_frames
+        << ", threads " << (profile.threads ? std::to_string(profile.threads) : "auto")
+        << " (" << profile.thread_type << ")";
+    if (profile.lookahead >= 0) out << ", lookahead " << profile.lookahead;
+    for (const auto& option : profile.codec_options) {
+        out << ", " << option.first << "=" << option.second;
+    }
+    out << std::endl;
+}
+
+#endif // ENCODER_PROFILE_H
@@ -2,218 +2,1949 @@
 #include <sstream>
 #include <iomanip>
 #include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
 
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/avutil.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/parseutils.h>
+#include <libavutil/pixdesc.h>
 #include <libswscale/swscale.h>
 }
 
-// Function to save frame as PPM (simple image format)
-void save_frame_as_ppm(AVFrame* frame, int width, int height, int frame_number) {
+#include "decoder_threading.h"
+
+std::string frame_filename(int frame_number, const char* extension) {
     std::ostringstream filename;
-    filename << "frame_" << std::setfill('0') << std::setw(6) << frame_number << ".ppm";
-    
-    FILE* file = fopen(filename.str().c_str(), "wb");
+    filename << "frame_" << std::setfill('0') << std::setw(6) << frame_number << "." << extension;
+    return filename.str();
+}
+
+std::string sprite_filename(int sheet_number, const char* extension) {
+    std::ostringstream filename;
+    filename << "sprite_" << std::setfill('0') << std::setw(6) << sheet_number << "." << extension;
+    return filename.str();
+}
+
+#ifndef _WIN32
+// Write every iovec completely: writev may write less than asked for and
+// takes at most IOV_MAX entries per call
+bool write_iovecs(int fd, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, std::min(count, IOV_MAX));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+            iov->iov_len -= written;
+        }
+    }
+    return true;
+}
+#endif
+
+// Function to save RGB24 pixels as PPM (simple image format). Header and
+// pixels go out in one writev when rows are packed; otherwise the rows are
+// gathered with one iovec each, without stdio buffering in between.
+bool save_frame_as_ppm(const uint8_t* pixels, int linesize, int width, int height, const std::string& filename) {
+    char header[32];
+    int header_size = std::snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+    size_t row_bytes = (size_t)width * 3;
+    bool ok = true;
+
+#ifdef _WIN32
+    FILE* file = fopen(filename.c_str(), "wb");
     if (!file) {
-        std::cerr << "Could not open file " << filename.str() << std::endl;
-        return;
+        std::cerr << "Could not open file " << filename << std::endl;
+        return false;
+    }
+    ok = fwrite(header, 1, header_size, file) == (size_t)header_size;
+    for (int y = 0; y < height && ok; y++) {
+        ok = fwrite(pixels + (size_t)y * linesize, 1, row_bytes, file) == row_bytes;
+    }
+    ok = fclose(file) == 0 && ok;
+#else
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Could not open file " << filename << std::endl;
+        return false;
+    }
+    
+    bool packed = (size_t)linesize == row_bytes;
+    int rows = packed ? 1 : height;
+    std::vector<struct iovec> iov(rows + 1);
+    iov[0].iov_base = header;
+    iov[0].iov_len = header_size;
+    for (int y = 0; y < rows; y++) {
+        iov[y + 1].iov_base = const_cast<uint8_t*>(pixels) + (size_t)y * linesize;
+        iov[y + 1].iov_len = packed ? row_bytes * height : row_bytes;
+    }
+    ok = write_iovecs(fd, iov.data(), (int)iov.size());
+    ok = close(fd) == 0 && ok;
+#endif
+
+    if (!ok) {
+        std::cerr << "Error writing " << filename << std::endl;
+    }
+    return ok;
+}
+
+// Raw frame archive: every extracted frame in one memory-mapped file that
+// ML preprocessing can map directly instead of decoding image files.
+//
+// File layout (host byte order, like the probe cache):
+//   FrameArchiveHeader, then packed RGB24 frames, each starting on a
+//   FRAME_ARCHIVE_ALIGNMENT boundary, then frame_count FrameArchiveEntry
+//   records at table_offset (frame number, timestamp, byte offset).
+// The data area is preallocated for the expected frame count and doubled
+// when it runs out. Converters scale straight into their frame's slot.
+struct FrameArchiveHeader {
+    char magic[8];          // "FRAMEARC"
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;      // 3 (packed RGB24)
+    uint64_t frame_size;    // width * height * channels
+    uint64_t frame_count;
+    uint64_t table_offset;
+};
+
+struct FrameArchiveEntry {
+    int64_t frame_number;
+    double timestamp;       // Seconds from the start of the stream
+    uint64_t offset;
+};
+
+constexpr uint32_t FRAME_ARCHIVE_VERSION = 1;
+constexpr size_t FRAME_ARCHIVE_ALIGNMENT = 4096;
+
+class FrameArchive {
+public:
+    ~FrameArchive() {
+        finish();
+    }
+    
+    bool open(const std::string& archive_path, int frame_width, int frame_height, size_t expected_frames) {
+#ifdef _WIN32
+        std::cerr << "Frame archives need mmap, which this platform does not provide" << std::endl;
+        return false;
+#else
+        path = archive_path;
+        width = frame_width;
+        height = frame_height;
+        frame_size = (size_t)width * height * 3;
+        frame_stride = (frame_size + FRAME_ARCHIVE_ALIGNMENT - 1) / FRAME_ARCHIVE_ALIGNMENT * FRAME_ARCHIVE_ALIGNMENT;
+        
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            std::cerr << "Could not open file " << path << std::endl;
+            return false;
+        }
+        return grow(std::max<size_t>(expected_frames, 1));
+#endif
     }
     
-    // Write PPM header
-    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    // Slot for the next frame, in submission order; decode thread only
+    int add_frame(int frame_number, double timestamp) {
+        entries.push_back({frame_number, timestamp, frame_offset(entries.size())});
+        return (int)entries.size() - 1;
+    }
     
-    // Write pixel data
-    for (int y = 0; y < height; y++) {
-        fwrite(frame->data[0] + y * frame->linesize[0], 1, width * 3, file);
+    // Run fill(pixels, linesize) on the slot's mapped memory
+    template <typename Fill>
+    bool write_frame(int slot, Fill&& fill) {
+        while (true) {
+            {
+                std::shared_lock<std::shared_mutex> lock(mapping_mutex);
+                if ((size_t)slot < capacity) {
+                    fill(mapping + frame_offset(slot), width * 3);
+                    return true;
+                }
+            }
+            std::unique_lock<std::shared_mutex> lock(mapping_mutex);
+            if ((size_t)slot >= capacity && !grow(std::max<size_t>(slot + 1, capacity * 2))) {
+                return false;
+            }
+        }
     }
     
-    fclose(file);
-    std::cout << "Saved frame " << frame_number << " as " << filename.str() << std::endl;
+    // Trim the unused slots, append the offset table and fill in the header.
+    // Call once every write_frame has returned.
+    bool finish() {
+#ifdef _WIN32
+        return true;
+#else
+        if (fd < 0) {
+            return true;
+        }
+        
+        bool ok = mapping != nullptr;
+        uint64_t table_offset = frame_offset(entries.size());
+        if (mapping) {
+            FrameArchiveHeader header = {};
+            std::memcpy(header.magic, "FRAMEARC", sizeof(header.magic));
+            header.version = FRAME_ARCHIVE_VERSION;
+            header.width = width;
+            header.height = height;
+            header.channels = 3;
+            header.frame_size = frame_size;
+            header.frame_count = entries.size();
+            header.table_offset = table_offset;
+            std::memcpy(mapping, &header, sizeof(header));
+            ok = msync(mapping, mapped_size, MS_SYNC) == 0;
+            munmap(mapping, mapped_size);
+            mapping = nullptr;
+        }
+        
+        size_t table_size = entries.size() * sizeof(FrameArchiveEntry);
+        ok = ok && ftruncate(fd, table_offset + table_size) == 0;
+        ok = ok && (table_size == 0 ||
+                    pwrite(fd, entries.data(), table_size, table_offset) == (ssize_t)table_size);
+        ok = close(fd) == 0 && ok;
+        fd = -1;
+        
+        if (!ok) {
+            std::cerr << "Error writing " << path << std::endl;
+        }
+        return ok;
+#endif
+    }
+    
+    size_t frame_bytes() const {
+        return frame_size;
+    }
+    
+private:
+    std::string path;
+    int fd = -1;
+    int width = 0;
+    int height = 0;
+    size_t frame_size = 0;
+    size_t frame_stride = 0;
+    uint8_t* mapping = nullptr;
+    size_t mapped_size = 0;
+    size_t capacity = 0;        // Frames the mapping can hold
+    std::shared_mutex mapping_mutex;
+    std::vector<FrameArchiveEntry> entries;
+    
+    uint64_t frame_offset(size_t slot) const {
+        return FRAME_ARCHIVE_ALIGNMENT + slot * frame_stride;
+    }
+    
+    // Extend the file to hold frame_count frames and map it again
+    bool grow(size_t frame_count) {
+#ifdef _WIN32
+        return false;
+#else
+        if (mapping) {
+            munmap(mapping, mapped_size);
+            mapping = nullptr;
+            capacity = 0;
+        }
+        
+        size_t size = frame_offset(frame_count);
+        if (ftruncate(fd, size) != 0) {
+            std::cerr << "Could not grow " << path << " to " << size << " bytes" << std::endl;
+            return false;
+        }
+        void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            std::cerr << "Could not map " << path << std::endl;
+            return false;
+        }
+        
+        mapping = static_cast<uint8_t*>(mapped);
+        mapped_size = size;
+        capacity = frame_count;
+        return true;
+#endif
+    }
+};
+
+// Fixed-capacity blocking queue between pipeline stages. push() waits while
+// the queue is full, which is what throttles the decoder when output lags.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t queue_capacity) : capacity(queue_capacity) {}
+    
+    // Returns false once the queue is closed
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this] { return items.size() < capacity || closed; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+    
+    // Returns false when the queue is closed and fully drained
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this] { return !items.empty() || closed; });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+    
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+    
+private:
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+};
+
+// Reusable image buffers of one size. acquire() blocks once `limit` buffers
+// are in flight, so memory stays bounded however far the writers fall behind.
+class BufferPool {
+public:
+    BufferPool(size_t size, size_t max_buffers) : buffer_size(size), limit(max_buffers) {}
+    
+    ~BufferPool() {
+        for (uint8_t* buffer : free_buffers) {
+            av_free(buffer);
+        }
+    }
+    
+    // Returns nullptr if a new buffer could not be allocated
+    uint8_t* acquire() {
+        std::unique_lock<std::mutex> lock(mutex);
+        available.wait(lock, [this] { return !free_buffers.empty() || allocated < limit; });
+        if (!free_buffers.empty()) {
+            uint8_t* buffer = free_buffers.back();
+            free_buffers.pop_back();
+            return buffer;
+        }
+        uint8_t* buffer = (uint8_t*)av_malloc(buffer_size);
+        if (buffer) {
+            allocated++;
+        }
+        return buffer;
+    }
+    
+    void release(uint8_t* buffer) {
+        std::lock_guard<std::mutex> lock(mutex);
+        free_buffers.push_back(buffer);
+        available.notify_one();
+    }
+    
+    size_t allocated_count() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return allocated;
+    }
+    
+private:
+    size_t buffer_size;
+    size_t limit;
+    size_t allocated = 0;
+    std::vector<uint8_t*> free_buffers;
+    std::mutex mutex;
+    std::condition_variable available;
+};
+
+// Output image formats. PPM is written directly; the others go through a
+// libavcodec image encoder.
+enum class ImageFormat { Ppm, Png, Jpeg, Webp };
+
+bool parse_image_format(const std::string& name, ImageFormat& format) {
+    if (name == "ppm") {
+        format = ImageFormat::Ppm;
+    } else if (name == "png") {
+        format = ImageFormat::Png;
+    } else if (name == "jpeg" || name == "jpg") {
+        format = ImageFormat::Jpeg;
+    } else if (name == "webp") {
+        format = ImageFormat::Webp;
+    } else {
+        return false;
+    }
+    return true;
 }
 
-int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <input_file> <frame_interval>" << std::endl;
-        std::cerr << "Example: " << argv[0] << " video.mp4 30" << std::endl;
-        std::cerr << "This will extract every 30th frame" << std::endl;
-        return 1;
+const char* image_extension(ImageFormat format) {
+    switch (format) {
+        case ImageFormat::Png: return "png";
+        case ImageFormat::Jpeg: return "jpg";
+        case ImageFormat::Webp: return "webp";
+        default: return "ppm";
+    }
+}
+
+// nullptr for PPM, or when FFmpeg was built without the encoder (webp needs libwebp)
+const AVCodec* find_image_encoder(ImageFormat format) {
+    switch (format) {
+        case ImageFormat::Png: return avcodec_find_encoder(AV_CODEC_ID_PNG);
+        case ImageFormat::Jpeg: return avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+        case ImageFormat::Webp: return avcodec_find_encoder_by_name("libwebp");
+        default: return nullptr;
+    }
+}
+
+// Pixel format the colour converters produce for the encoder: its natural
+// input (full-range 4:2:0 for JPEG, 4:2:0 for lossy WebP, RGB for PNG) when
+// supported, otherwise the first format it accepts
+AVPixelFormat encoder_pixel_format(ImageFormat format, const AVCodec* codec) {
+    if (!codec) {
+        return AV_PIX_FMT_RGB24;
     }
     
-    const char* input_filename = argv[1];
-    int frame_interval = std::atoi(argv[2]);
+    AVPixelFormat preferred = format == ImageFormat::Jpeg ? AV_PIX_FMT_YUVJ420P :
+                              format == ImageFormat::Webp ? AV_PIX_FMT_YUV420P : AV_PIX_FMT_RGB24;
     
-    if (frame_interval <= 0) {
-        std::cerr << "Frame interval must be positive" << std::endl;
-        return 1;
+    const void* configs = nullptr;
+    int config_count = 0;
+    if (avcodec_get_supported_config(nullptr, codec, AV_CODEC_CONFIG_PIX_FORMAT, 0, &configs, &config_count) < 0 ||
+        !configs || config_count == 0) {
+        return preferred;
     }
     
-    // Initialize variables at the beginning
-    AVFormatContext* format_ctx = nullptr;
+    const AVPixelFormat* formats = static_cast<const AVPixelFormat*>(configs);
+    for (int i = 0; i < config_count; i++) {
+        if (formats[i] == preferred) {
+            return preferred;
+        }
+    }
+    return formats[0];
+}
+
+// Tensor batches for ML inference: N frames of planar RGB (NCHW) per file,
+// as uint8 or as float32 normalized to (x / 255 - mean) / std
+enum class TensorType { None, Uint8, Float32 };
+
+// Tensor batch file layout (host byte order, memory-mappable):
+//   TensorBatchHeader, then one TensorFrameEntry per slot of the batch size
+//   (the first `batch` are valid), then the N x 3 x H x W data at data_offset,
+//   64-byte aligned.
+struct TensorBatchHeader {
+    char magic[8];          // "FETENSOR"
+    uint32_t version;
+    uint32_t dtype;         // 0 = uint8, 1 = float32
+    uint32_t batch;         // N: frames in this file
+    uint32_t channels;      // C: 3 (R, G, B)
+    uint32_t height;        // H
+    uint32_t width;         // W
+    uint64_t data_offset;
+    float mean[3];
+    float std_dev[3];
+};
+
+struct TensorFrameEntry {
+    int64_t frame_number;
+    double timestamp;       // Seconds from the start of the stream
+};
+
+constexpr uint32_t TENSOR_BATCH_VERSION = 1;
+
+std::string tensor_filename(int batch_number) {
+    std::ostringstream filename;
+    filename << "batch_" << std::setfill('0') << std::setw(6) << batch_number << ".tensor";
+    return filename.str();
+}
+
+// (x / 255 - mean) / std for each of the three planes, as one multiply-add
+// per element so the compiler vectorizes the loop
+void normalize_planes(const uint8_t* src, float* dst, size_t plane_size, const float mean[3], const float std_dev[3]) {
+    for (int c = 0; c < 3; c++) {
+        const uint8_t* in = src + c * plane_size;
+        float* out = dst + c * plane_size;
+        float scale = 1.0f / (255.0f * std_dev[c]);
+        float bias = -mean[c] / std_dev[c];
+        for (size_t i = 0; i < plane_size; i++) {
+            out[i] = in[i] * scale + bias;
+        }
+    }
+}
+
+struct PipelineOptions {
+    int converters = 2;     // Colour conversion workers, one SwsContext each
+    int writers = 0;        // Image writers/encoders (0 = 2 for PPM, one per core otherwise)
+    ImageFormat format = ImageFormat::Ppm;
+    int quality = 0;        // 1-100 for JPEG/WebP (0 = encoder default)
+    int thumbnail_width = 0;    // Output size of each frame (0 = source size)
+    int thumbnail_height = 0;
+    int sprite_columns = 0;     // Tiles per sprite sheet (0 = one image per frame)
+    int sprite_rows = 0;
+    std::string archive_path;   // Raw frame archive instead of image files
+    size_t expected_frames = 0; // Initial archive size
+    TensorType tensor = TensorType::None;
+    int batch_size = 16;        // Frames per tensor file
+    float mean[3] = {0.0f, 0.0f, 0.0f};     // float32 normalization per RGB channel
+    float std_dev[3] = {1.0f, 1.0f, 1.0f};
+};
+
+// Plane pointers of the pixel at (x, y) in an image. x and y must be
+// multiples of the chroma subsampling factors.
+void image_pointers_at(const AVFrame* image, int x, int y, uint8_t* data[4]) {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)image->format);
+    std::fill(data, data + 4, nullptr);
+    for (int c = 0; c < desc->nb_components; c++) {
+        const AVComponentDescriptor& comp = desc->comp[c];
+        bool chroma = !(desc->flags & AV_PIX_FMT_FLAG_RGB) && (c == 1 || c == 2);
+        int plane_x = chroma ? x >> desc->log2_chroma_w : x;
+        int plane_y = chroma ? y >> desc->log2_chroma_h : y;
+        data[comp.plane] = image->data[comp.plane] + (ptrdiff_t)plane_y * image->linesize[comp.plane] +
+                           plane_x * comp.step;
+    }
+}
+
+// Unused tiles of the last sprite sheet stay black
+void fill_image_black(AVFrame* image) {
+    ptrdiff_t linesizes[4];
+    for (int i = 0; i < 4; i++) {
+        linesizes[i] = image->linesize[i];
+    }
+    AVColorRange range = image->format == AV_PIX_FMT_YUVJ420P ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
+    av_image_fill_black(image->data, linesizes, (AVPixelFormat)image->format, range, image->width, image->height);
+}
+
+// WebVTT cue time: hh:mm:ss.mmm
+std::string vtt_timestamp(double seconds) {
+    int64_t ms = std::llround(std::max(0.0, seconds) * 1000);
+    std::ostringstream out;
+    out << std::setfill('0') << std::setw(2) << ms / 3600000 << ":"
+        << std::setw(2) << ms / 60000 % 60 << ":"
+        << std::setw(2) << ms / 1000 % 60 << "."
+        << std::setw(3) << ms % 1000;
+    return out.str();
+}
+
+// One libavcodec image encoder per writer thread: codec contexts are not
+// shared between threads, so the writer pool is also the encoder pool.
+class ImageEncoder {
+public:
+    ~ImageEncoder() {
+        av_packet_free(&packet);
+        avcodec_free_context(&codec_ctx);
+    }
+    
+    bool open(const AVCodec* codec, const AVFrame* image, int quality) {
+        codec_ctx = avcodec_alloc_context3(codec);
+        packet = av_packet_alloc();
+        if (!codec_ctx || !packet) {
+            std::cerr << "Could not allocate " << codec->name << " encoder" << std::endl;
+            return false;
+        }
+        
+        codec_ctx->width = image->width;
+        codec_ctx->height = image->height;
+        codec_ctx->pix_fmt = (AVPixelFormat)image->format;
+        codec_ctx->time_base = {1, 25};
+        codec_ctx->thread_count = 1;    // Parallelism comes from the writer pool
+        if (quality > 0) {
+            // mjpeg maps quality onto qscale 2 (best) .. 31; libwebp takes 0-100 directly
+            double scale = codec->id == AV_CODEC_ID_MJPEG ? 2 + (100 - quality) * 29 / 99.0 : quality;
+            codec_ctx->flags |= AV_CODEC_FLAG_QSCALE;
+            codec_ctx->global_quality = (int)(scale * FF_QP2LAMBDA);
+        }
+        
+        int ret = avcodec_open2(codec_ctx, codec, nullptr);
+        if (ret < 0) {
+            char error_buf[AV_ERROR_MAX_STRING_SIZE];
+            av_strerror(ret, error_buf, AV_ERROR_MAX_STRING_SIZE);
+            std::cerr << "Could not open " << codec->name << " encoder: " << error_buf << std::endl;
+            return false;
+        }
+        opened = true;
+        return true;
+    }
+    
+    bool is_open() const {
+        return opened;
+    }
+    
+    // Image encoders return one packet per frame; it is written with one fwrite
+    bool encode(const AVFrame* image, const std::string& filename) {
+        int ret = avcodec_send_frame(codec_ctx, image);
+        if (ret >= 0) {
+            ret = avcodec_receive_packet(codec_ctx, packet);
+        }
+        if (ret < 0) {
+            std::cerr << "Could not encode " << filename << std::endl;
+            return false;
+        }
+        
+        bool ok = false;
+        FILE* file = fopen(filename.c_str(), "wb");
+        if (!file) {
+            std::cerr << "Could not open file " << filename << std::endl;
+        } else {
+            ok = fwrite(packet->data, 1, packet->size, file) == (size_t)packet->size;
+            ok = fclose(file) == 0 && ok;
+            if (!ok) {
+                std::cerr << "Error writing " << filename << std::endl;
+            }
+        }
+        
+        encoded_bytes += packet->size;
+        av_packet_unref(packet);
+        return ok;
+    }
+    
+    int64_t bytes() const {
+        return encoded_bytes;
+    }
+    
+private:
     AVCodecContext* codec_ctx = nullptr;
-    SwsContext* sws_ctx = nullptr;
     AVPacket* packet = nullptr;
-    AVFrame* frame = nullptr;
-    AVFrame* rgb_frame = nullptr;
-    uint8_t* rgb_buffer = nullptr;
-    int video_stream_index = -1;
-    int frame_count = 0;
-    int saved_count = 0;
-    int ret = 0;
+    bool opened = false;
+    int64_t encoded_bytes = 0;
+};
+
+// Asynchronous output: decode -> colour convert -> encode/write. The decode
+// thread only takes a reference to each selected frame; conversion and
+// encoding run on their own workers, connected by bounded queues. Converted
+// images are refcounted AVFrames whose buffers go back to the pool when freed.
+//
+// Each frame is scaled to the output size and format in a single sws_scale
+// call. Sprite sheets and tensor batches collect several frames: that call
+// writes straight into the frame's slot of a shared batch buffer, which goes
+// to the writers once all of its slots are filled.
+class ExtractPipeline {
+public:
+    ExtractPipeline(int output_width, int output_height, const PipelineOptions& pipeline_options)
+        : tile_width(output_width), tile_height(output_height), options(pipeline_options),
+          sprite(pipeline_options.sprite_columns > 0),
+          tensor(pipeline_options.tensor != TensorType::None),
+          slots_per_batch(sprite ? pipeline_options.sprite_columns * pipeline_options.sprite_rows :
+                          tensor ? pipeline_options.batch_size : 1),
+          image_width(output_width * std::max(1, pipeline_options.sprite_columns)),
+          image_height(output_height * std::max(1, pipeline_options.sprite_rows)),
+          encoder(tensor ? nullptr : find_image_encoder(pipeline_options.format)),
+          // GBRP is planar RGB: the tensor's channel planes in a different order
+          pixel_format(tensor ? AV_PIX_FMT_GBRP : encoder_pixel_format(pipeline_options.format, encoder)),
+          convert_queue(pipeline_options.converters * 2),
+          write_queue(pipeline_options.writers * 2),
+          buffers(image_buffer_size(), max_pool_buffers(pipeline_options)) {}
     
-    // Open input file
-    ret = avformat_open_input(&format_ctx, input_filename, nullptr, nullptr);
-    if (ret < 0) {
-        char error_buf[AV_ERROR_MAX_STRING_SIZE];
-        av_strerror(ret, error_buf, AV_ERROR_MAX_STRING_SIZE);
-        std::cerr << "Error opening file: " << error_buf << std::endl;
-        return 1;
+    ~ExtractPipeline() {
+        finish();
+    }
+    
+    // False when the selected format has no encoder in this FFmpeg build
+    // or the archive cannot be created
+    bool start() {
+        if (options.format != ImageFormat::Ppm && !encoder) {
+            std::cerr << "No " << image_extension(options.format) << " encoder in this FFmpeg build" << std::endl;
+            return false;
+        }
+        if (!options.archive_path.empty()) {
+            archive.reset(new FrameArchive());
+            if (!archive->open(options.archive_path, tile_width, tile_height, options.expected_frames)) {
+                archive.reset();
+                return false;
+            }
+        }
+        
+        for (int i = 0; i < options.converters; i++) {
+            workers.emplace_back(&ExtractPipeline::convert_worker, this);
+        }
+        for (int i = 0; i < options.writers; i++) {
+            writer_threads.emplace_back(&ExtractPipeline::write_worker, this);
+        }
+        return true;
+    }
+    
+    // Queue a decoded frame; the frame is referenced, not copied.
+    // timestamp (seconds) is only used for the sprite index.
+    bool submit(const AVFrame* frame, int frame_number, double timestamp) {
+        AVFrame* reference = av_frame_clone(frame);
+        if (!reference) {
+            std::cerr << "Could not reference frame " << frame_number << std::endl;
+            return false;
+        }
+        int slot = sprite || tensor ? next_slot : archive ? archive->add_frame(frame_number, timestamp) : -1;
+        if (!convert_queue.push({reference, frame_number, slot, timestamp})) {
+            std::cerr << "Output pipeline stopped; frame " << frame_number << " not saved" << std::endl;
+            av_frame_free(&reference);
+            return false;
+        }
+        if (sprite) {
+            tiles.push_back({frame_number, timestamp});
+        }
+        if (sprite || tensor) {
+            next_slot++;
+        }
+        return true;
+    }
+    
+    // Drain every stage in order and join the workers
+    void finish() {
+        convert_queue.close();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+        
+        // The last batch is usually only partly filled
+        for (auto& entry : batches) {
+            queue_batch(entry.second.image, entry.first, entry.second.filled);
+        }
+        batches.clear();
+        
+        write_queue.close();
+        for (std::thread& writer : writer_threads) {
+            writer.join();
+        }
+        writer_threads.clear();
+        
+        if (archive) {
+            archive->finish();
+            archive.reset();
+        }
+    }
+    
+    int saved() const {
+        return saved_count;
+    }
+    
+    int64_t bytes_written() const {
+        return output_bytes;
+    }
+    
+    size_t buffers_allocated() {
+        return buffers.allocated_count();
+    }
+    
+    const char* encoder_name() const {
+        return tensor ? (options.tensor == TensorType::Uint8 ? "uint8 tensor" : "float32 tensor") :
+               encoder ? encoder->name : "ppm";
+    }
+    
+    // Frames placed in sprite sheets or tensor batches
+    int batched_frames() const {
+        return next_slot;
+    }
+    
+    // Tile coordinates of every submitted frame, as WebVTT thumbnail cues
+    // (sprite_000000.jpg#xywh=x,y,w,h) or as JSON when the path ends in .json.
+    // Each tile is shown until the next one starts; the last until end_time.
+    bool write_sprite_index(const std::string& path, double end_time) const {
+        std::ofstream out(path);
+        if (!out) {
+            std::cerr << "Could not open file " << path << std::endl;
+            return false;
+        }
+        
+        bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+        if (json) {
+            out << "{\"tile_width\":" << tile_width << ",\"tile_height\":" << tile_height
+                << ",\"columns\":" << options.sprite_columns << ",\"rows\":" << options.sprite_rows
+                << ",\"tiles\":[";
+        } else {
+            out << "WEBVTT\n";
+        }
+        
+        out << std::fixed << std::setprecision(3);
+        for (size_t i = 0; i < tiles.size(); i++) {
+            int position = (int)i % slots_per_batch;
+            int x = position % options.sprite_columns * tile_width;
+            int y = position / options.sprite_columns * tile_height;
+            std::string sheet = sprite_filename((int)i / slots_per_batch, image_extension(options.format));
+            double start = tiles[i].timestamp;
+            double end = i + 1 < tiles.size() ? tiles[i + 1].timestamp : std::max(end_time, start);
+            
+            if (json) {
+                out << (i ? "," : "") << "\n{\"frame\":" << tiles[i].frame_number
+                    << ",\"start\":" << start << ",\"end\":" << end
+                    << ",\"sheet\":\"" << sheet << "\",\"x\":" << x << ",\"y\":" << y << "}";
+            } else {
+                out << "\n" << vtt_timestamp(start) << " --> " << vtt_timestamp(end) << "\n"
+                    << sheet << "#xywh=" << x << "," << y << "," << tile_width << "," << tile_height << "\n";
+            }
+        }
+        if (json) {
+            out << "\n]}\n";
+        }
+        
+        out.close();
+        if (!out) {
+            std::cerr << "Error writing " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+private:
+    struct ImageJob {
+        AVFrame* frame;
+        int frame_number;   // Batch number for finished sprite sheets and tensor batches
+        int slot = -1;      // Sprite tile, tensor frame or archive frame index
+        double timestamp = 0.0;
+    };
+    
+    struct SpriteTile {
+        int frame_number;
+        double timestamp;
+    };
+    
+    struct Batch {
+        AVFrame* image = nullptr;
+        int filled = 0;
+    };
+    
+    int tile_width;
+    int tile_height;
+    PipelineOptions options;
+    bool sprite;
+    bool tensor;
+    int slots_per_batch;
+    int image_width;
+    int image_height;
+    const AVCodec* encoder;
+    AVPixelFormat pixel_format;
+    BoundedQueue<ImageJob> convert_queue;
+    BoundedQueue<ImageJob> write_queue;
+    BufferPool buffers;
+    std::vector<std::thread> workers;
+    std::vector<std::thread> writer_threads;
+    std::atomic<int> saved_count{0};
+    std::atomic<int64_t> output_bytes{0};
+    std::mutex log_mutex;
+    int next_slot = 0;                      // Decode thread only
+    std::vector<SpriteTile> tiles;          // Decode thread only
+    std::map<int, Batch> batches;           // Batches still being filled
+    std::mutex batch_mutex;
+    std::unique_ptr<FrameArchive> archive;
+    
+    size_t tensor_element_size() const {
+        return options.tensor == TensorType::Float32 ? sizeof(float) : 1;
+    }
+    
+    size_t tensor_frame_bytes() const {
+        return (size_t)3 * tile_width * tile_height * tensor_element_size();
+    }
+    
+    size_t tensor_data_offset() const {
+        size_t table_end = sizeof(TensorBatchHeader) + slots_per_batch * sizeof(TensorFrameEntry);
+        return (table_end + 63) / 64 * 64;
+    }
+    
+    // Images in flight: one per converter plus what the write queue and the
+    // writers hold. A tensor buffer is a whole batch (hundreds of MB at 1080p
+    // float32), so there the limit does not grow with the writers: one open
+    // batch per converter, the one still being filled, and one being written.
+    // Fewer could leave every buffer in half-filled batches.
+    static size_t max_pool_buffers(const PipelineOptions& pipeline_options) {
+        if (pipeline_options.tensor != TensorType::None) {
+            return pipeline_options.converters + 2;
+        }
+        return pipeline_options.converters + pipeline_options.writers * 3;
+    }
+    
+    // Pool buffers hold one output image, sprite sheet or whole tensor file
+    size_t image_buffer_size() const {
+        if (tensor) {
+            return tensor_data_offset() + slots_per_batch * tensor_frame_bytes();
+        }
+        return av_image_get_buffer_size(pixel_format, image_width, image_height, 1);
+    }
+    
+    static void release_to_pool(void* opaque, uint8_t* data) {
+        static_cast<BufferPool*>(opaque)->release(data);
+    }
+    
+    // Wrap a pool buffer in a refcounted frame of the output format
+    AVFrame* acquire_image() {
+        uint8_t* pixels = buffers.acquire();
+        AVFrame* image = av_frame_alloc();
+        if (!pixels || !image) {
+            if (pixels) buffers.release(pixels);
+            av_frame_free(&image);
+            return nullptr;
+        }
+        
+        image->buf[0] = av_buffer_create(pixels, image_buffer_size(), release_to_pool, &buffers, 0);
+        if (!image->buf[0]) {
+            buffers.release(pixels);
+            av_frame_free(&image);
+            return nullptr;
+        }
+        
+        image->width = image_width;
+        image->height = image_height;
+        if (tensor) {
+            image->data[0] = pixels;    // Raw tensor file, laid out by the converters
+            return image;
+        }
+        image->format = pixel_format;
+        av_image_fill_arrays(image->data, image->linesize, pixels, pixel_format, image_width, image_height, 1);
+        return image;
+    }
+    
+    // Buffer of the sheet or tensor batch a slot belongs to, taken from the
+    // pool when its first slot arrives
+    AVFrame* open_batch(int batch_number) {
+        std::lock_guard<std::mutex> lock(batch_mutex);
+        Batch& batch = batches[batch_number];
+        if (!batch.image) {
+            batch.image = acquire_image();
+            if (batch.image && tensor) {
+                std::memset(batch.image->data[0], 0, tensor_data_offset());
+            } else if (batch.image) {
+                fill_image_black(batch.image);
+            }
+        }
+        return batch.image;
+    }
+    
+    // Count a finished slot; the last one sends the batch to the writers
+    void close_slot(int batch_number) {
+        AVFrame* image;
+        {
+            std::lock_guard<std::mutex> lock(batch_mutex);
+            auto it = batches.find(batch_number);
+            if (++it->second.filled < slots_per_batch) {
+                return;
+            }
+            image = it->second.image;
+            batches.erase(it);
+        }
+        queue_batch(image, batch_number, slots_per_batch);
+    }
+    
+    void queue_batch(AVFrame* image, int batch_number, int filled) {
+        if (image && tensor) {
+            // Written last, so a partial batch records only its filled slots
+            TensorBatchHeader header = {};
+            std::memcpy(header.magic, "FETENSOR", sizeof(header.magic));
+            header.version = TENSOR_BATCH_VERSION;
+            header.dtype = options.tensor == TensorType::Float32 ? 1 : 0;
+            header.batch = filled;
+            header.channels = 3;
+            header.height = tile_height;
+            header.width = tile_width;
+            header.data_offset = tensor_data_offset();
+            std::copy(options.mean, options.mean + 3, header.mean);
+            std::copy(options.std_dev, options.std_dev + 3, header.std_dev);
+            std::memcpy(image->data[0], &header, sizeof(header));
+        }
+        if (image && !write_queue.push({image, batch_number})) {
+            av_frame_free(&image);
+        }
     }
     
-    // Find stream information
-    ret = avformat_find_stream_info(format_ctx, nullptr);
-    if (ret < 0) {
-        std::cerr << "Could not find stream information" << std::endl;
-        goto cleanup;
+    // Scale straight into the tile's place in its sheet
+    void convert_tile(SwsContext* sws_ctx, const ImageJob& job) {
+        int sheet_number = job.slot / slots_per_batch;
+        int position = job.slot % slots_per_batch;
+        AVFrame* sheet = open_batch(sheet_number);
+        
+        if (sheet && sws_ctx) {
+            uint8_t* tile[4];
+            image_pointers_at(sheet, position % options.sprite_columns * tile_width,
+                              position / options.sprite_columns * tile_height, tile);
+            sws_scale(sws_ctx, job.frame->data, job.frame->linesize, 0, job.frame->height,
+                      tile, sheet->linesize);
+        } else {
+            std::cerr << "Could not convert frame " << job.frame_number << std::endl;
+        }
+        close_slot(sheet_number);
     }
     
-    // Find video stream
-    for (unsigned int i = 0; i < format_ctx->nb_streams; i++) {
-        if (format_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-            video_stream_index = i;
-            break;
+    // One sws_scale does colour conversion, resize and the planar layout:
+    // GBRP planes are pointed at the tensor's G, B and R channels. uint8
+    // tensors are written in place; float32 goes through a per-worker
+    // uint8 scratch frame and one normalizing pass.
+    void convert_to_tensor(SwsContext* sws_ctx, const ImageJob& job, std::vector<uint8_t>& scratch) {
+        int batch_number = job.slot / slots_per_batch;
+        int position = job.slot % slots_per_batch;
+        AVFrame* batch = open_batch(batch_number);
+        
+        if (batch && sws_ctx) {
+            uint8_t* file = batch->data[0];
+            TensorFrameEntry entry = {job.frame_number, job.timestamp};
+            std::memcpy(file + sizeof(TensorBatchHeader) + position * sizeof(entry), &entry, sizeof(entry));
+            
+            size_t plane_size = (size_t)tile_width * tile_height;
+            uint8_t* frame_data = file + tensor_data_offset() + position * tensor_frame_bytes();
+            bool float_output = options.tensor == TensorType::Float32;
+            if (float_output) {
+                scratch.resize(plane_size * 3);
+            }
+            uint8_t* rgb = float_output ? scratch.data() : frame_data;
+            
+            uint8_t* planes[4] = {rgb + plane_size, rgb + 2 * plane_size, rgb, nullptr};
+            int linesizes[4] = {tile_width, tile_width, tile_width, 0};
+            sws_scale(sws_ctx, job.frame->data, job.frame->linesize, 0, job.frame->height, planes, linesizes);
+            if (float_output) {
+                normalize_planes(rgb, reinterpret_cast<float*>(frame_data), plane_size, options.mean, options.std_dev);
+            }
+        } else {
+            std::cerr << "Could not convert frame " << job.frame_number << std::endl;
         }
+        close_slot(batch_number);
     }
     
-    if (video_stream_index == -1) {
-        std::cerr << "Could not find video stream" << std::endl;
-        goto cleanup;
+    // Scale straight into the frame's slot of the mapped archive
+    void convert_to_archive(SwsContext* sws_ctx, const ImageJob& job) {
+        bool ok = sws_ctx && archive->write_frame(job.slot, [&](uint8_t* pixels, int linesize) {
+            uint8_t* data[4] = {pixels, nullptr, nullptr, nullptr};
+            int linesizes[4] = {linesize, 0, 0, 0};
+            sws_scale(sws_ctx, job.frame->data, job.frame->linesize, 0, job.frame->height, data, linesizes);
+        });
+        if (!ok) {
+            std::cerr << "Could not convert frame " << job.frame_number << std::endl;
+            return;
+        }
+        
+        saved_count++;
+        output_bytes += archive->frame_bytes();
+        std::lock_guard<std::mutex> lock(log_mutex);
+        std::cout << "Saved frame " << job.frame_number << " to archive slot " << job.slot << std::endl;
+    }
+    
+    void convert_worker() {
+        SwsContext* sws_ctx = nullptr;
+        std::vector<uint8_t> scratch;
+        ImageJob job;
+        
+        while (convert_queue.pop(job)) {
+            // Cached per worker; rebuilt only if the source size or format changes.
+            // Area averaging keeps large downscales (thumbnails) from aliasing.
+            bool downscale = tile_width < job.frame->width || tile_height < job.frame->height;
+            sws_ctx = sws_getCachedContext(sws_ctx,
+                job.frame->width, job.frame->height, (AVPixelFormat)job.frame->format,
+                tile_width, tile_height, pixel_format,
+                downscale ? SWS_AREA : SWS_BILINEAR, nullptr, nullptr, nullptr);
+            
+            if (sprite || tensor || archive) {
+                if (sprite) {
+                    convert_tile(sws_ctx, job);
+                } else if (tensor) {
+                    convert_to_tensor(sws_ctx, job, scratch);
+                } else {
+                    convert_to_archive(sws_ctx, job);
+                }
+                av_frame_free(&job.frame);
+                continue;
+            }
+            
+            AVFrame* image = acquire_image();
+            if (!image || !sws_ctx) {
+                std::cerr << "Could not convert frame " << job.frame_number << std::endl;
+                av_frame_free(&image);
+                av_frame_free(&job.frame);
+                continue;
+            }
+            
+            sws_scale(sws_ctx, job.frame->data, job.frame->linesize, 0, job.frame->height,
+                      image->data, image->linesize);
+            av_frame_free(&job.frame);
+            
+            if (!write_queue.push({image, job.frame_number})) {
+                av_frame_free(&image);
+            }
+        }
+        
+        sws_freeContext(sws_ctx);
+    }
+    
+    void write_worker() {
+        ImageEncoder image_encoder;
+        ImageJob job;
+        
+        while (write_queue.pop(job)) {
+            if (tensor) {
+                write_tensor_batch(job);
+                continue;
+            }
+            
+            const char* extension = image_extension(options.format);
+            std::string filename = sprite ? sprite_filename(job.frame_number, extension) :
+                                            frame_filename(job.frame_number, extension);
+            bool ok;
+            if (!encoder) {
+                ok = save_frame_as_ppm(job.frame->data[0], job.frame->linesize[0], image_width, image_height, filename);
+                if (ok) {
+                    output_bytes += (int64_t)image_width * image_height * 3;
+                }
+            } else {
+                // Opened on first use so every worker gets its own context
+                ok = (image_encoder.is_open() || image_encoder.open(encoder, job.frame, options.quality)) &&
+                     image_encoder.encode(job.frame, filename);
+            }
+            av_frame_free(&job.frame);
+            
+            if (ok) {
+                saved_count++;
+                std::lock_guard<std::mutex> lock(log_mutex);
+                std::cout << "Saved " << (sprite ? "sprite sheet " : "frame ") << job.frame_number
+                          << " as " << filename << std::endl;
+            }
+        }
+        output_bytes += image_encoder.bytes();
     }
     
-    // Get codec parameters and setup decoder
-    {
+    // The batch buffer already has the file layout: one fwrite
+    void write_tensor_batch(ImageJob& job) {
+        TensorBatchHeader header;
+        std::memcpy(&header, job.frame->data[0], sizeof(header));
+        size_t size = header.data_offset + header.batch * tensor_frame_bytes();
+        std::string filename = tensor_filename(job.frame_number);
+        
+        bool ok = false;
+        FILE* file = fopen(filename.c_str(), "wb");
+        if (!file) {
+            std::cerr << "Could not open file " << filename << std::endl;
+        } else {
+            ok = fwrite(job.frame->data[0], 1, size, file) == size;
+            ok = fclose(file) == 0 && ok;
+            if (!ok) {
+                std::cerr << "Error writing " << filename << std::endl;
+            }
+        }
+        av_frame_free(&job.frame);
+        
+        if (ok) {
+            saved_count++;
+            output_bytes += size;
+            std::lock_guard<std::mutex> lock(log_mutex);
+            std::cout << "Saved tensor batch " << job.frame_number << " (" << header.batch
+                      << " frames) as " << filename << std::endl;
+        }
+    }
+};
+
+// How frames are located:
+//   decode     - decode every frame and keep every n-th (exact, slowest)
+//   seek       - seek to the keyframe before each target and decode forward to it
+//   keyframes  - send only keyframe packets to the decoder and keep every n-th
+//   timestamps - like seek, for an explicit list of times (--timestamps)
+enum class ExtractMode { Decode, Seek, Keyframes, Timestamps };
+
+struct ExtractOptions {
+    int frame_interval = 0;
+    ExtractMode mode = ExtractMode::Decode;
+    std::vector<int64_t> timestamps;    // AV_TIME_BASE units from the start of the stream
+    DecoderThreading threading;
+    PipelineOptions pipeline;
+    std::string sprite_index = "sprites.vtt";   // .vtt or .json
+};
+
+// Parse "a,b,c" into three floats (per-channel normalization)
+bool parse_channels(const char* text, float values[3]) {
+    return std::sscanf(text, "%f,%f,%f", &values[0], &values[1], &values[2]) == 3;
+}
+
+// Default thumbnail width when only --sprite is given
+constexpr int DEFAULT_THUMBNAIL_WIDTH = 160;
+
+// Parse "WxH" or "W"; a missing or zero dimension is derived from the other
+bool parse_size(const char* text, int& width, int& height) {
+    width = height = 0;
+    int matched = std::sscanf(text, "%dx%d", &width, &height);
+    return matched >= 1 && width >= 0 && height >= 0 && (width > 0 || height > 0);
+}
+
+bool parse_extract_mode(const std::string& name, ExtractMode& mode) {
+    if (name == "decode") {
+        mode = ExtractMode::Decode;
+    } else if (name == "seek") {
+        mode = ExtractMode::Seek;
+    } else if (name == "keyframes") {
+        mode = ExtractMode::Keyframes;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* extract_mode_name(ExtractMode mode) {
+    switch (mode) {
+        case ExtractMode::Seek: return "seek";
+        case ExtractMode::Keyframes: return "keyframes";
+        case ExtractMode::Timestamps: return "timestamps";
+        default: return "decode";
+    }
+}
+
+// Parse comma-separated times ("12.5", "1:02.5", "00:01:02.500") and append
+// them in AV_TIME_BASE units
+bool parse_timestamp_list(const std::string& list, std::vector<int64_t>& timestamps) {
+    std::istringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        item.erase(0, item.find_first_not_of(" \t\r"));
+        item.erase(item.find_last_not_of(" \t\r") + 1);
+        if (item.empty()) {
+            continue;
+        }
+        int64_t timestamp;
+        if (av_parse_time(&timestamp, item.c_str(), 1) < 0 || timestamp < 0) {
+            std::cerr << "Invalid timestamp: " << item << std::endl;
+            return false;
+        }
+        timestamps.push_back(timestamp);
+    }
+    return true;
+}
+
+// One or more timestamps per line; '#' starts a comment
+bool read_timestamp_file(const char* path, std::vector<int64_t>& timestamps) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Could not open timestamp file " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        line = line.substr(0, line.find('#'));
+        if (!parse_timestamp_list(line, timestamps)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A seek-mode target: stream timestamp and the frame number to save it as
+// (0 = the number of the frame actually found)
+struct SeekTarget {
+    int64_t timestamp;
+    int frame_number;
+};
+
+// Without an index, seek only when the next target is at least this far ahead
+constexpr double NO_INDEX_SEEK_GAP_SECONDS = 2.0;
+
+class FrameExtractor {
+private:
+    ExtractOptions options;
+    AVFormatContext* format_ctx = nullptr;
+    AVCodecContext* codec_ctx = nullptr;
+    AVPacket* packet = nullptr;
+    AVFrame* frame = nullptr;
+    std::unique_ptr<ExtractPipeline> pipeline;
+    int video_stream_index = -1;
+    
+    int frames_decoded = 0;
+    int seek_count = 0;
+    size_t seek_targets_done = 0;
+    int64_t start_pts = 0;
+    bool submit_failed = false;     // A frame could not be queued: stop and fail the run
+    
+public:
+    explicit FrameExtractor(const ExtractOptions& extract_options) : options(extract_options) {}
+    
+    ~FrameExtractor() {
+        cleanup();
+    }
+    
+    bool open(const char* filename) {
+        // Open input file
+        int ret = avformat_open_input(&format_ctx, filename, nullptr, nullptr);
+        if (ret < 0) {
+            print_error("Error opening file", ret);
+            return false;
+        }
+        
+        // Find stream information
+        ret = avformat_find_stream_info(format_ctx, nullptr);
+        if (ret < 0) {
+            std::cerr << "Could not find stream information" << std::endl;
+            return false;
+        }
+        
+        // Find video stream
+        for (unsigned int i = 0; i < format_ctx->nb_streams; i++) {
+            if (format_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+                video_stream_index = i;
+                break;
+            }
+        }
+        
+        if (video_stream_index == -1) {
+            std::cerr << "Could not find video stream" << std::endl;
+            return false;
+        }
+        
+        // Get codec parameters and setup decoder
         AVCodecParameters* codecpar = format_ctx->streams[video_stream_index]->codecpar;
         
         // Find decoder
         const AVCodec* codec = avcodec_find_decoder(codecpar->codec_id);
         if (!codec) {
             std::cerr << "Unsupported codec" << std::endl;
-            goto cleanup;
+            return false;
         }
         
         // Allocate codec context
         codec_ctx = avcodec_alloc_context3(codec);
         if (!codec_ctx) {
             std::cerr << "Could not allocate codec context" << std::endl;
-            goto cleanup;
+            return false;
         }
         
         // Copy codec parameters to context
         ret = avcodec_parameters_to_context(codec_ctx, codecpar);
         if (ret < 0) {
             std::cerr << "Could not copy codec parameters" << std::endl;
-            goto cleanup;
+            return false;
+        }
+        
+        if (!configure_decoder_threads(codec_ctx, options.threading)) {
+            return false;
+        }
+        
+        if (options.mode == ExtractMode::Keyframes) {
+            // Safety net for codecs that flag more packets as key than they decode as such
+            codec_ctx->skip_frame = AVDISCARD_NONKEY;
         }
         
         // Open codec
         ret = avcodec_open2(codec_ctx, codec, nullptr);
         if (ret < 0) {
             std::cerr << "Could not open codec" << std::endl;
-            goto cleanup;
+            return false;
+        }
+        
+        // Allocate frames
+        packet = av_packet_alloc();
+        frame = av_frame_alloc();
+        
+        if (!packet || !frame) {
+            std::cerr << "Could not allocate packet or frames" << std::endl;
+            return false;
+        }
+        
+        AVStream* stream = format_ctx->streams[video_stream_index];
+        start_pts = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+        
+        // Frames are scaled straight to the output size, so no full-resolution
+        // RGB copy exists. Thumbnail sizes keep the display aspect ratio.
+        int output_width = codec_ctx->width;
+        int output_height = codec_ctx->height;
+        if (options.pipeline.thumbnail_width > 0 || options.pipeline.thumbnail_height > 0) {
+            AVRational sar = av_guess_sample_aspect_ratio(format_ctx, stream, nullptr);
+            double display_width = codec_ctx->width * (sar.num > 0 && sar.den > 0 ? av_q2d(sar) : 1.0);
+            double aspect = display_width / codec_ctx->height;
+            output_width = options.pipeline.thumbnail_width;
+            output_height = options.pipeline.thumbnail_height;
+            if (output_width == 0) {
+                output_width = (int)std::lround(output_height * aspect);
+            } else if (output_height == 0) {
+                output_height = (int)std::lround(output_width / aspect);
+            }
+            // Even sizes keep 4:2:0 tiles aligned to chroma samples
+            output_width = std::max(2, output_width & ~1);
+            output_height = std::max(2, output_height & ~1);
+        }
+        
+        if (!options.pipeline.archive_path.empty()) {
+            options.pipeline.expected_frames = expected_saved_frames(stream);
+        }
+        
+        // Colour conversion and file writing run on the pipeline's workers
+        pipeline.reset(new ExtractPipeline(output_width, output_height, options.pipeline));
+        if (!pipeline->start()) {
+            return false;
         }
+        
+        std::cout << "Extracting frames from: " << filename << std::endl;
+        std::cout << "Video resolution: " << codec_ctx->width << "x" << codec_ctx->height << std::endl;
+        if (output_width != codec_ctx->width || output_height != codec_ctx->height) {
+            std::cout << "Thumbnail size: " << output_width << "x" << output_height << std::endl;
+        }
+        if (options.pipeline.sprite_columns > 0) {
+            std::cout << "Sprite sheet: " << options.pipeline.sprite_columns << "x" << options.pipeline.sprite_rows
+                      << " tiles, index " << options.sprite_index << std::endl;
+        }
+        if (options.pipeline.tensor != TensorType::None) {
+            const float* mean = options.pipeline.mean;
+            const float* std_dev = options.pipeline.std_dev;
+            std::cout << "Tensor batches: " << options.pipeline.batch_size << "x3x" << output_height << "x" << output_width;
+            if (options.pipeline.tensor == TensorType::Float32) {
+                std::cout << " float32, mean " << mean[0] << "," << mean[1] << "," << mean[2]
+                          << " std " << std_dev[0] << "," << std_dev[1] << "," << std_dev[2];
+            } else {
+                std::cout << " uint8";
+            }
+            std::cout << std::endl;
+        }
+        if (!options.pipeline.archive_path.empty()) {
+            std::cout << "Archive: " << options.pipeline.archive_path << " (room for "
+                      << options.pipeline.expected_frames << " frames, grows as needed)" << std::endl;
+        }
+        if (options.mode == ExtractMode::Timestamps) {
+            std::cout << "Timestamps: " << options.timestamps.size() << std::endl;
+        } else {
+            std::cout << "Frame interval: " << options.frame_interval << std::endl;
+        }
+        std::cout << "Mode: " << extract_mode_name(options.mode) << std::endl;
+        std::cout << "Decoder threads: " << codec_ctx->thread_count << std::endl;
+        std::cout << "Output: " << pipeline->encoder_name();
+        if (options.pipeline.quality > 0) {
+            std::cout << " (quality " << options.pipeline.quality << ")";
+        }
+        std::cout << std::endl;
+        std::cout << "Pipeline: " << options.pipeline.converters << " converters, "
+                  << options.pipeline.writers << " writers" << std::endl << std::endl;
+        
+        return true;
     }
     
-    // Initialize scaling context for RGB conversion
-    sws_ctx = sws_getContext(
-        codec_ctx->width, codec_ctx->height, codec_ctx->pix_fmt,
-        codec_ctx->width, codec_ctx->height, AV_PIX_FMT_RGB24,
-        SWS_BILINEAR, nullptr, nullptr, nullptr
-    );
+    bool run() {
+        auto start_time = std::chrono::steady_clock::now();
+        
+        bool ok;
+        switch (options.mode) {
+            case ExtractMode::Seek: ok = run_seek(); break;
+            case ExtractMode::Keyframes: ok = run_keyframes(); break;
+            case ExtractMode::Timestamps: ok = run_timestamps(); break;
+            default: ok = run_decode(); break;
+        }
+        
+        // Wait for queued frames to be converted and written
+        pipeline->finish();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        
+        std::cout << "\nExtraction complete!" << std::endl;
+        std::cout << "Total frames processed: " << frames_decoded << std::endl;
+        if (options.pipeline.sprite_columns > 0) {
+            std::cout << "Thumbnails: " << pipeline->batched_frames() << std::endl;
+            std::cout << "Sprite sheets saved: " << pipeline->saved() << std::endl;
+        } else if (options.pipeline.tensor != TensorType::None) {
+            std::cout << "Frames saved: " << pipeline->batched_frames() << std::endl;
+            std::cout << "Tensor batches saved: " << pipeline->saved() << std::endl;
+        } else {
+            std::cout << "Frames saved: " << pipeline->saved() << std::endl;
+        }
+        if (options.mode == ExtractMode::Seek || options.mode == ExtractMode::Timestamps) {
+            std::cout << "Seeks: " << seek_count << std::endl;
+        }
+        std::cout << "Output size: " << std::fixed << std::setprecision(2)
+                  << pipeline->bytes_written() / (1024.0 * 1024.0) << " MB" << std::endl;
+        std::cout << "Image buffers allocated: " << pipeline->buffers_allocated() << std::endl;
+        std::cout << "Elapsed time: " << std::fixed << std::setprecision(3) << elapsed << " seconds" << std::endl;
+        
+        if (options.pipeline.sprite_columns > 0) {
+            double duration = format_ctx->duration > 0 ? format_ctx->duration / (double)AV_TIME_BASE : 0.0;
+            ok = pipeline->write_sprite_index(options.sprite_index, duration) && ok;
+        }
+        return ok;
+    }
     
-    if (!sws_ctx) {
-        std::cerr << "Could not initialize scaling context" << std::endl;
-        goto cleanup;
+private:
+    // Frames the interval will select, from the container's frame count or
+    // duration; only sizes the archive, which grows if the guess is short
+    size_t expected_saved_frames(AVStream* stream) {
+        if (options.mode == ExtractMode::Timestamps) {
+            return std::max<size_t>(options.timestamps.size(), 1);
+        }
+        int64_t frame_count = stream->nb_frames;
+        AVRational frame_rate = av_guess_frame_rate(format_ctx, stream, nullptr);
+        if (frame_count <= 0 && format_ctx->duration > 0 && frame_rate.num > 0) {
+            frame_count = av_rescale_q(format_ctx->duration, AVRational{1, AV_TIME_BASE}, av_inv_q(frame_rate));
+        }
+        if (options.mode == ExtractMode::Keyframes) {
+            frame_count /= 10;  // Rough guess without reading the index
+        }
+        return std::max<int64_t>(frame_count / options.frame_interval + 1, 16);
     }
     
-    // Allocate frames
-    packet = av_packet_alloc();
-    frame = av_frame_alloc();
-    rgb_frame = av_frame_alloc();
+    // Send one packet (nullptr drains the decoder) and pass each decoded
+    // frame to on_frame, which returns false to stop receiving early.
+    // Returns 0 or a negative error code.
+    template <typename FrameHandler>
+    int decode_packet(const AVPacket* input, FrameHandler&& on_frame) {
+        int ret = avcodec_send_packet(codec_ctx, input);
+        if (ret < 0) {
+            std::cerr << "Error sending packet to decoder" << std::endl;
+            return ret;
+        }
+        
+        while (true) {
+            ret = avcodec_receive_frame(codec_ctx, frame);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+                return 0;
+            } else if (ret < 0) {
+                std::cerr << "Error during decoding" << std::endl;
+                return ret;
+            }
+            
+            frames_decoded++;
+            bool keep_going = on_frame(frame);
+            av_frame_unref(frame);
+            if (!keep_going) {
+                return 0;
+            }
+        }
+    }
     
-    if (!packet || !frame || !rgb_frame) {
-        std::cerr << "Could not allocate packet or frames" << std::endl;
-        goto cleanup;
+    // Read every packet; at end of file an empty packet drains the frames the
+    // decoder still holds (frame threading keeps one per thread)
+    bool run_decode() {
+        while (true) {
+            bool end_of_file = av_read_frame(format_ctx, packet) < 0;
+            int ret = 0;
+            
+            if (end_of_file || packet->stream_index == video_stream_index) {
+                ret = decode_packet(end_of_file ? nullptr : packet, [this](AVFrame* decoded) {
+                    // Save frame if it matches our interval
+                    if (frames_decoded % options.frame_interval == 0) {
+                        return save_frame(decoded, frames_decoded);
+                    }
+                    return true;
+                });
+            }
+            av_packet_unref(packet);
+            
+            if (ret < 0 || submit_failed) {
+                return false;
+            }
+            if (end_of_file) {
+                return true;
+            }
+        }
     }
     
-    // Allocate buffer for RGB frame
-    {
-        int rgb_buffer_size = av_image_get_buffer_size(AV_PIX_FMT_RGB24, codec_ctx->width, codec_ctx->height, 1);
-        rgb_buffer = (uint8_t*)av_malloc(rgb_buffer_size);
+    // Same targets as decode mode (frames n, 2n, 3n, ... at the nominal frame
+    // rate), each reached by seeking to the preceding keyframe
+    bool run_seek() {
+        AVStream* stream = format_ctx->streams[video_stream_index];
+        AVRational time_base = stream->time_base;
+        AVRational frame_rate = av_guess_frame_rate(format_ctx, stream, nullptr);
+        if (frame_rate.num <= 0 || frame_rate.den <= 0) {
+            std::cerr << "Frame rate unknown; use --mode decode" << std::endl;
+            return false;
+        }
         
-        if (!rgb_buffer) {
-            std::cerr << "Could not allocate RGB buffer" << std::endl;
-            goto cleanup;
+        int64_t end_ts = INT64_MAX;
+        if (format_ctx->duration > 0) {
+            end_ts = start_pts + av_rescale_q(format_ctx->duration, AVRational{1, AV_TIME_BASE}, time_base);
         }
         
-        av_image_fill_arrays(rgb_frame->data, rgb_frame->linesize, rgb_buffer, 
-                            AV_PIX_FMT_RGB24, codec_ctx->width, codec_ctx->height, 1);
+        // Targets are 1-based frame numbers, like the file names in decode mode
+        std::vector<SeekTarget> targets;
+        for (int number = options.frame_interval; ; number += options.frame_interval) {
+            int64_t target_ts = start_pts + av_rescale_q(number - 1, av_inv_q(frame_rate), time_base);
+            if (target_ts >= end_ts) {
+                break;
+            }
+            targets.push_back({target_ts, number});
+        }
+        return seek_to_targets(targets);
     }
     
-    std::cout << "Extracting frames from: " << input_filename << std::endl;
-    std::cout << "Video resolution: " << codec_ctx->width << "x" << codec_ctx->height << std::endl;
-    std::cout << "Frame interval: " << frame_interval << std::endl << std::endl;
+    // Requested times, sorted so that the targets in one GOP are all served
+    // by a single seek and a single forward decode. Each saved frame is the
+    // one on screen at the requested time, named by its own frame number.
+    bool run_timestamps() {
+        AVStream* stream = format_ctx->streams[video_stream_index];
+        std::vector<int64_t> times = options.timestamps;
+        std::sort(times.begin(), times.end());
+        times.erase(std::unique(times.begin(), times.end()), times.end());
+        
+        // Times past the known duration would only cost a seek to the last GOP
+        std::vector<SeekTarget> targets;
+        for (int64_t time : times) {
+            if (format_ctx->duration <= 0 || time < format_ctx->duration) {
+                targets.push_back({start_pts + av_rescale_q(time, AVRational{1, AV_TIME_BASE}, stream->time_base), 0});
+            }
+        }
+        
+        bool ok = seek_to_targets(targets);
+        size_t missed = times.size() - seek_targets_done;
+        if (missed > 0) {
+            std::cerr << missed << " timestamp(s) past the end of the stream" << std::endl;
+        }
+        return ok;
+    }
     
-    // Read frames
-    while (av_read_frame(format_ctx, packet) >= 0) {
-        if (packet->stream_index == video_stream_index) {
-            ret = avcodec_send_packet(codec_ctx, packet);
-            if (ret < 0) {
-                std::cerr << "Error sending packet to decoder" << std::endl;
-                break;
+    // Decode forward from the keyframe before each target (sorted by
+    // timestamp) up to the frame whose display interval covers it. Targets
+    // whose keyframe lies within the packets already read are reached by
+    // decoding on, so each GOP is decoded at most once.
+    bool seek_to_targets(const std::vector<SeekTarget>& targets) {
+        AVStream* stream = format_ctx->streams[video_stream_index];
+        AVRational frame_rate = av_guess_frame_rate(format_ctx, stream, nullptr);
+        int64_t frame_step = 1;
+        if (frame_rate.num > 0 && frame_rate.den > 0) {
+            frame_step = std::max<int64_t>(1, av_rescale_q(1, av_inv_q(frame_rate), stream->time_base));
+        }
+        
+        size_t next = 0;
+        int64_t last_dts = AV_NOPTS_VALUE;
+        bool seek_pending = true;
+        
+        while (next < targets.size()) {
+            if (seek_pending) {
+                seek_pending = false;
+                if (keyframe_ahead(targets[next].timestamp, last_dts)) {
+                    int ret = av_seek_frame(format_ctx, video_stream_index, targets[next].timestamp, AVSEEK_FLAG_BACKWARD);
+                    if (ret < 0) {
+                        print_error("Seek failed", ret);
+                        return false;
+                    }
+                    avcodec_flush_buffers(codec_ctx);
+                    last_dts = AV_NOPTS_VALUE;
+                    seek_count++;
+                }
             }
             
-            while (ret >= 0) {
-                ret = avcodec_receive_frame(codec_ctx, frame);
-                if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-                    break;
-                } else if (ret < 0) {
-                    std::cerr << "Error during decoding" << std::endl;
-                    goto cleanup;
+            bool end_of_file = av_read_frame(format_ctx, packet) < 0;
+            if (!end_of_file && packet->stream_index != video_stream_index) {
+                av_packet_unref(packet);
+                continue;
+            }
+            if (!end_of_file) {
+                last_dts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+            }
+            
+            int ret = decode_packet(end_of_file ? nullptr : packet, [&](AVFrame* decoded) {
+                int64_t pts = decoded->best_effort_timestamp;
+                if (pts == AV_NOPTS_VALUE) {
+                    return true;
+                }
+                int64_t frame_end = pts + (decoded->duration > 0 ? decoded->duration : frame_step);
+                if (frame_end <= targets[next].timestamp) {
+                    return true;    // Still before the target: decoded only as a reference
                 }
                 
-                frame_count++;
-                
-                // Save frame if it matches our interval
-                if (frame_count % frame_interval == 0) {
-                    // Convert to RGB
-                    sws_scale(sws_ctx, frame->data, frame->linesize, 0, codec_ctx->height,
-                             rgb_frame->data, rgb_frame->linesize);
-                    
-                    // Save frame
-                    save_frame_as_ppm(rgb_frame, codec_ctx->width, codec_ctx->height, frame_count);
-                    saved_count++;
+                int frame_number = targets[next].frame_number;
+                if (!save_frame(decoded, frame_number > 0 ? frame_number : frame_number_at(pts))) {
+                    return false;
                 }
                 
-                av_frame_unref(frame);
+                // A frame can cover several targets when they are close
+                // together or the stream is variable frame rate
+                do {
+                    next++;
+                    seek_targets_done++;
+                } while (next < targets.size() && targets[next].timestamp < frame_end);
+                
+                // Frames still queued in the decoder are dropped by the flush
+                seek_pending = true;
+                return next < targets.size() && !keyframe_ahead(targets[next].timestamp, last_dts);
+            });
+            av_packet_unref(packet);
+            
+            if (ret < 0 || submit_failed) {
+                return false;
+            }
+            if (end_of_file) {
+                break;
+            }
+        }
+        return true;
+    }
+    
+    // Seeking pays off only when the keyframe before the target lies beyond
+    // the packets already read; otherwise decoding forward is cheaper.
+    bool keyframe_ahead(int64_t target_ts, int64_t last_dts) {
+        if (last_dts == AV_NOPTS_VALUE) {
+            return true;
+        }
+        
+        AVStream* stream = format_ctx->streams[video_stream_index];
+        const AVIndexEntry* entry = avformat_index_get_entry_from_timestamp(stream, target_ts, AVSEEK_FLAG_BACKWARD);
+        if (entry) {
+            return entry->timestamp > last_dts;
+        }
+        
+        int64_t gap = av_rescale_q(target_ts - last_dts, stream->time_base, AVRational{1, AV_TIME_BASE});
+        return gap > NO_INDEX_SEEK_GAP_SECONDS * AV_TIME_BASE;
+    }
+    
+    // Only keyframe packets reach the decoder, so nothing but intra frames is
+    // decoded. Every n-th keyframe is saved, named by its estimated frame number.
+    bool run_keyframes() {
+        while (true) {
+            bool end_of_file = av_read_frame(format_ctx, packet) < 0;
+            int ret = 0;
+            
+            bool keyframe_packet = !end_of_file && packet->stream_index == video_stream_index &&
+                                   (packet->flags & AV_PKT_FLAG_KEY);
+            if (end_of_file || keyframe_packet) {
+                ret = decode_packet(end_of_file ? nullptr : packet, [&](AVFrame* decoded) {
+                    if (frames_decoded % options.frame_interval == 0) {
+                        int64_t pts = decoded->best_effort_timestamp;
+                        return save_frame(decoded, pts != AV_NOPTS_VALUE ? frame_number_at(pts) : frames_decoded);
+                    }
+                    return true;
+                });
+            }
+            av_packet_unref(packet);
+            
+            if (ret < 0 || submit_failed) {
+                return false;
+            }
+            if (end_of_file) {
+                return true;
             }
         }
-        av_packet_unref(packet);
     }
     
-    std::cout << "\nExtraction complete!" << std::endl;
-    std::cout << "Total frames processed: " << frame_count << std::endl;
-    std::cout << "Frames saved: " << saved_count << std::endl;
+    // 1-based frame number of a timestamp at the nominal frame rate
+    int frame_number_at(int64_t pts) {
+        AVStream* stream = format_ctx->streams[video_stream_index];
+        AVRational frame_rate = av_guess_frame_rate(format_ctx, stream, nullptr);
+        if (frame_rate.num <= 0 || frame_rate.den <= 0) {
+            return frames_decoded;
+        }
+        return (int)av_rescale_q(pts - start_pts, stream->time_base, av_inv_q(frame_rate)) + 1;
+    }
     
-cleanup:
-    if (rgb_buffer) av_free(rgb_buffer);
-    if (packet) av_packet_free(&packet);
-    if (frame) av_frame_free(&frame);
-    if (rgb_frame) av_frame_free(&rgb_frame);
-    if (sws_ctx) sws_freeContext(sws_ctx);
-    if (codec_ctx) avcodec_free_context(&codec_ctx);
-    if (format_ctx) avformat_close_input(&format_ctx);
+    // Hand the frame to the output pipeline; blocks while its queue is full.
+    // Returns false (and marks the run failed) if the frame was dropped.
+    bool save_frame(const AVFrame* decoded, int frame_number) {
+        double timestamp = 0.0;
+        if (decoded->best_effort_timestamp != AV_NOPTS_VALUE) {
+            AVRational time_base = format_ctx->streams[video_stream_index]->time_base;
+            timestamp = (decoded->best_effort_timestamp - start_pts) * av_q2d(time_base);
+        }
+        if (!pipeline->submit(decoded, frame_number, timestamp)) {
+            submit_failed = true;
+            return false;
+        }
+        return true;
+    }
+    
+    void cleanup() {
+        // Workers may still hold frame references: stop them before the decoder goes
+        pipeline.reset();
+        if (packet) av_packet_free(&packet);
+        if (frame) av_frame_free(&frame);
+        if (codec_ctx) avcodec_free_context(&codec_ctx);
+        if (format_ctx) avformat_close_input(&format_ctx);
+    }
+    
+    void print_error(const char* message, int error_code) {
+        char error_buf[AV_ERROR_MAX_STRING_SIZE];
+        av_strerror(error_code, error_buf, AV_ERROR_MAX_STRING_SIZE);
+        std::cerr << message << ": " << error_buf << std::endl;
+    }
+};
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <input_file> <frame_interval>" << std::endl;
+    std::cerr << "       " << program << " [options] --timestamps <t1,t2,...> <input_file>" << std::endl;
+    std::cerr << "Example: " << program << " video.mp4 30" << std::endl;
+    std::cerr << "This will extract every 30th frame" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --mode <mode>          decode: decode every frame (default)" << std::endl;
+    std::cerr << "                         seek: seek to the keyframe before each target and decode forward" << std::endl;
+    std::cerr << "                         keyframes: decode keyframes only, save every n-th keyframe" << std::endl;
+    std::cerr << "  --timestamps <list>    Save the frame shown at each time (seconds or [hh:]mm:ss.xxx, comma-separated)" << std::endl;
+    std::cerr << "  --timestamps-file <f>  Same, read from a file (commas or one per line, # comments)" << std::endl;
+    std::cerr << "  --threads <n>          Decoder threads (default: 0 = one per CPU core)" << std::endl;
+    std::cerr << "  --thread-type <mode>   frame, slice or auto (default: auto)" << std::endl;
+    std::cerr << "  --converters <n>       Colour conversion threads (default: 2)" << std::endl;
+    std::cerr << "  --writers <n>          Image writer/encoder threads (default: 2 for ppm, one per core otherwise)" << std::endl;
+    std::cerr << "  --format <fmt>         ppm (default), png, jpeg or webp (needs FFmpeg with libwebp)" << std::endl;
+    std::cerr << "  --quality <1-100>      JPEG/WebP quality (default: encoder default)" << std::endl;
+    std::cerr << "  --thumbnail <WxH>      Scale frames to this size; W or H may be 0 to keep the aspect ratio" << std::endl;
+    std::cerr << "  --sprite <CxR>         Tile thumbnails into C columns x R rows per sprite sheet" << std::endl;
+    std::cerr << "  --sprite-index <file>  Tile index for sprite sheets, .vtt or .json (default: sprites.vtt)" << std::endl;
+    std::cerr << "  --archive <file>       Write all frames as raw RGB24 into one memory-mapped archive" << std::endl;
+    std::cerr << "  --tensor <type>        Write NCHW tensor batches (batch_000000.tensor): u8 or f32" << std::endl;
+    std::cerr << "  --batch <n>            Frames per tensor batch (default: 16)" << std::endl;
+    std::cerr << "  --mean <r,g,b>         f32 normalization: (x / 255 - mean) / std (default: 0,0,0)" << std::endl;
+    std::cerr << "  --std <r,g,b>          (default: 1,1,1)" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<const char*> positional;
+    bool timestamps_given = false;
+    bool mode_given = false;
+    ExtractOptions options;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            options.threading.thread_count = std::atoi(argv[++i]);
+            if (options.threading.thread_count < 0) {
+                std::cerr << "Thread count must not be negative" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--thread-type" && i + 1 < argc) {
+            options.threading.thread_type = argv[++i];
+        } else if ((arg == "--converters" || arg == "--writers") && i + 1 < argc) {
+            int count = std::atoi(argv[++i]);
+            if (count <= 0) {
+                std::cerr << arg << " must be positive" << std::endl;
+                return 1;
+            }
+            (arg == "--converters" ? options.pipeline.converters : options.pipeline.writers) = count;
+        } else if (arg == "--format" && i + 1 < argc) {
+            if (!parse_image_format(argv[++i], options.pipeline.format)) {
+                std::cerr << "Unknown format: " << argv[i] << " (use ppm, png, jpeg or webp)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--quality" && i + 1 < argc) {
+            options.pipeline.quality = std::atoi(argv[++i]);
+            if (options.pipeline.quality < 1 || options.pipeline.quality > 100) {
+                std::cerr << "Quality must be between 1 and 100" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--thumbnail" && i + 1 < argc) {
+            if (!parse_size(argv[++i], options.pipeline.thumbnail_width, options.pipeline.thumbnail_height)) {
+                std::cerr << "Invalid thumbnail size: " << argv[i] << " (use WxH)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--sprite" && i + 1 < argc) {
+            if (!parse_size(argv[++i], options.pipeline.sprite_columns, options.pipeline.sprite_rows) ||
+                options.pipeline.sprite_columns <= 0 || options.pipeline.sprite_rows <= 0) {
+                std::cerr << "Invalid sprite layout: " << argv[i] << " (use COLUMNSxROWS)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--sprite-index" && i + 1 < argc) {
+            options.sprite_index = argv[++i];
+        } else if (arg == "--archive" && i + 1 < argc) {
+            options.pipeline.archive_path = argv[++i];
+        } else if (arg == "--tensor" && i + 1 < argc) {
+            std::string type = argv[++i];
+            if (type == "u8" || type == "uint8") {
+                options.pipeline.tensor = TensorType::Uint8;
+            } else if (type == "f32" || type == "float32") {
+                options.pipeline.tensor = TensorType::Float32;
+            } else {
+                std::cerr << "Unknown tensor type: " << type << " (use u8 or f32)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--batch" && i + 1 < argc) {
+            options.pipeline.batch_size = std::atoi(argv[++i]);
+            if (options.pipeline.batch_size <= 0) {
+                std::cerr << "Batch size must be positive" << std::endl;
+                return 1;
+            }
+        } else if ((arg == "--mean" || arg == "--std") && i + 1 < argc) {
+            float* values = arg == "--mean" ? options.pipeline.mean : options.pipeline.std_dev;
+            if (!parse_channels(argv[++i], values)) {
+                std::cerr << arg << " takes three comma-separated values (r,g,b)" << std::endl;
+                return 1;
+            }
+            if (arg == "--std" && (values[0] <= 0 || values[1] <= 0 || values[2] <= 0)) {
+                std::cerr << "--std values must be positive" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--timestamps" && i + 1 < argc) {
+            if (!parse_timestamp_list(argv[++i], options.timestamps)) {
+                return 1;
+            }
+            timestamps_given = true;
+        } else if (arg == "--timestamps-file" && i + 1 < argc) {
+            if (!read_timestamp_file(argv[++i], options.timestamps)) {
+                return 1;
+            }
+            timestamps_given = true;
+        } else if (arg == "--mode" && i + 1 < argc) {
+            if (!parse_extract_mode(argv[++i], options.mode)) {
+                std::cerr << "Unknown mode: " << argv[i] << " (use decode, seek or keyframes)" << std::endl;
+                return 1;
+            }
+            mode_given = true;
+        } else if (arg.size() > 1 && arg[0] == '-' && arg[1] == '-') {
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+    
+    // Timestamp lists replace the frame interval and pick their own mode,
+    // whichever order the options were given in
+    if (timestamps_given) {
+        if (mode_given) {
+            std::cerr << "--timestamps cannot be combined with --mode" << std::endl;
+            return 1;
+        }
+        if (options.timestamps.empty()) {
+            std::cerr << "No timestamps given" << std::endl;
+            return 1;
+        }
+        options.mode = ExtractMode::Timestamps;
+    }
+    if (positional.size() != (timestamps_given ? 1u : 2u)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    
+    const char* input_filename = positional[0];
+    options.frame_interval = timestamps_given ? 1 : std::atoi(positional[1]);
+    
+    if (options.frame_interval <= 0) {
+        std::cerr << "Frame interval must be positive" << std::endl;
+        return 1;
+    }
+    
+    if (!options.pipeline.archive_path.empty() &&
+        (options.pipeline.sprite_columns > 0 || options.pipeline.format != ImageFormat::Ppm)) {
+        std::cerr << "--archive stores raw RGB24 frames; it cannot be combined with --sprite or --format" << std::endl;
+        return 1;
+    }
+    
+    if (options.pipeline.tensor != TensorType::None &&
+        (options.pipeline.sprite_columns > 0 || !options.pipeline.archive_path.empty() ||
+         options.pipeline.format != ImageFormat::Ppm)) {
+        std::cerr << "--tensor cannot be combined with --sprite, --archive or --format" << std::endl;
+        return 1;
+    }
+    
+    if (options.pipeline.sprite_columns > 0 && options.pipeline.thumbnail_width == 0 &&
+        options.pipeline.thumbnail_height == 0) {
+        options.pipeline.thumbnail_width = DEFAULT_THUMBNAIL_WIDTH;
+    }
+    
+    if (options.pipeline.writers == 0) {
+        // Encoding is CPU-bound, PPM writing is I/O-bound
+        options.pipeline.writers = options.pipeline.format == ImageFormat::Ppm ? 2 :
+                                   (int)std::max(1u, std::thread::hardware_concurrency());
+    }
+    
+    FrameExtractor extractor(options);
+    if (!extractor.open(input_filename)) {
+        return 1;
+    }
     
-    return 0;
+    return extractor.run() ? 0 : 1;
 }
@@ -0,0 +1,100 @@
+// Reference-counted video frames from an AVBufferPool, for feeding encoders
+// without av_frame_make_writable copies.
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <cstdint>
+#include <vector>
+
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+}
+
+// Reference-counted frames backed by an AVBufferPool. get() always attaches a
+// buffer the encoder no longer references, so frames are never copied; once
+// the pool holds more buffers than the encoder keeps in flight nothing new is
+// allocated. Buffers go back to the pool when the encoder drops its reference.
+class FramePool {
+public:
+    ~FramePool() {
+        av_buffer_pool_uninit(&pool);
+    }
+    
+    // Pre-allocates `reserve` buffers so steady state starts with a warm pool
+    bool init(enum AVPixelFormat pixel_format, int frame_width, int frame_height, int reserve) {
+        format = pixel_format;
+        width = frame_width;
+        height = frame_height;
+        
+        // Pad rows to 64 bytes like av_frame_get_buffer, for SIMD row writes
+        int ret = av_image_fill_linesizes(linesize, format, FFALIGN(width, 64));
+        if (ret < 0) {
+            return false;
+        }
+        size_t plane_sizes[4];
+        ptrdiff_t linesizes[4] = {linesize[0], linesize[1], linesize[2], linesize[3]};
+        ret = av_image_fill_plane_sizes(plane_sizes, format, height, linesizes);
+        if (ret < 0) {
+            return false;
+        }
+        size_t buffer_size = plane_sizes[0] + plane_sizes[1] + plane_sizes[2] + plane_sizes[3];
+        
+        pool = av_buffer_pool_init2(buffer_size, this, allocate, nullptr);
+        if (!pool) {
+            return false;
+        }
+        
+        std::vector<AVBufferRef*> warm;
+        for (int i = 0; i < reserve; i++) {
+            AVBufferRef* buffer = av_buffer_pool_get(pool);
+            if (!buffer) {
+                break;
+            }
+            warm.push_back(buffer);
+        }
+        for (AVBufferRef*& buffer : warm) {
+            av_buffer_unref(&buffer);
+        }
+        reserved = allocations;
+        return reserved == reserve;
+    }
+    
+    // Drops the frame's previous buffer and attaches a free one
+    bool get(AVFrame* frame) {
+        av_frame_unref(frame);
+        AVBufferRef* buffer = av_buffer_pool_get(pool);
+        if (!buffer) {
+            return false;
+        }
+        frame->buf[0] = buffer;
+        frame->format = format;
+        frame->width = width;
+        frame->height = height;
+        av_image_fill_pointers(frame->data, format, height, buffer->data, linesize);
+        for (int i = 0; i < 4; i++) {
+            frame->linesize[i] = linesize[i];
+        }
+        return true;
+    }
+    
+    int64_t allocation_count() const { return allocations; }
+    int64_t reserved_count() const { return reserved; }
+    
+private:
+    static AVBufferRef* allocate(void* opaque, size_t size) {
+        static_cast<FramePool*>(opaque)->allocations++;
+        return av_buffer_alloc(size);
+    }
+    
+    AVBufferPool* pool = nullptr;
+    enum AVPixelFormat format = AV_PIX_FMT_NONE;
+    int width = 0;
+    int height = 0;
+    int linesize[4] = {0, 0, 0, 0};
+    int64_t allocations = 0;
+    int64_t reserved = 0;
+};
+
+#endif // FRAME_POOL_H
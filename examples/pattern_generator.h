@@ -0,0 +1,438 @@
+// Synthetic YUV420P test patterns for encoder load tests.
+//
+// Patterns:
+//   gradient   moving diagonal luma ramp (the original simple-encoder pattern)
+//   bars       75% color bars (BT.601), static
+//   noise      uniform random luma, new every frame
+//   zoneplate  circular zone plate, rings drift by 1/32 cycle per frame
+//
+// Generation is kept well below encode cost: planes that never change
+// (chroma, and every plane of the bars) are written once per frame buffer,
+// gradient rows are copied out of a precomputed ramp, the noise rows come
+// from a SIMD xorshift128+ generator and the zone plate is split into
+// per-column sine/cosine tables so each row is a vectorizable multiply-add.
+#ifndef PATTERN_GENERATOR_H
+#define PATTERN_GENERATOR_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+enum class TestPattern { Gradient, Bars, Noise, ZonePlate };
+
+inline bool parse_test_pattern(const std::string& name, TestPattern& pattern) {
+    if (name == "gradient") {
+        pattern = TestPattern::Gradient;
+    } else if (name == "bars") {
+        pattern = TestPattern::Bars;
+    } else if (name == "noise") {
+        pattern = TestPattern::Noise;
+    } else if (name == "zoneplate") {
+        pattern = TestPattern::ZonePlate;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+inline const char* test_pattern_name(TestPattern pattern) {
+    switch (pattern) {
+        case TestPattern::Gradient: return "gradient";
+        case TestPattern::Bars: return "bars";
+        case TestPattern::Noise: return "noise";
+        case TestPattern::ZonePlate: return "zoneplate";
+    }
+    return "unknown";
+}
+
+// Four independent xorshift128+ lanes; every step yields 32 bytes in lane
+// order, so the scalar and SIMD kernels produce identical frames
+struct NoiseState {
+    alignas(32) uint64_t s0[4];
+    alignas(32) uint64_t s1[4];
+};
+
+// Fills blocks * 32 bytes of dst
+using NoiseBlockFunction = void (*)(uint8_t* dst, int blocks, NoiseState& state);
+
+inline void noise_blocks_scalar(uint8_t* dst, int blocks, NoiseState& state) {
+    for (int i = 0; i < blocks; i++) {
+        for (int lane = 0; lane < 4; lane++) {
+            uint64_t a = state.s0[lane];
+            uint64_t b = state.s1[lane];
+            a ^= a << 23;
+            state.s0[lane] = b;
+            state.s1[lane] = a ^ b ^ (a >> 17) ^ (b >> 26);
+            uint64_t value = state.s1[lane] + b;
+            std::memcpy(dst + i * 32 + lane * 8, &value, 8);
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+inline __m128i xorshift128plus_sse2(__m128i& s0, __m128i& s1) {
+    __m128i a = s0;
+    __m128i b = s1;
+    a = _mm_xor_si128(a, _mm_slli_epi64(a, 23));
+    s0 = b;
+    s1 = _mm_xor_si128(_mm_xor_si128(a, b), _mm_xor_si128(_mm_srli_epi64(a, 17), _mm_srli_epi64(b, 26)));
+    return _mm_add_epi64(s1, b);
+}
+
+inline void noise_blocks_sse2(uint8_t* dst, int blocks, NoiseState& state) {
+    __m128i lo0 = _mm_load_si128(reinterpret_cast<const __m128i*>(state.s0));
+    __m128i hi0 = _mm_load_si128(reinterpret_cast<const __m128i*>(state.s0 + 2));
+    __m128i lo1 = _mm_load_si128(reinterpret_cast<const __m128i*>(state.s1));
+    __m128i hi1 = _mm_load_si128(reinterpret_cast<const __m128i*>(state.s1 + 2));
+    for (int i = 0; i < blocks; i++) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 32), xorshift128plus_sse2(lo0, lo1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 32 + 16), xorshift128plus_sse2(hi0, hi1));
+    }
+    _mm_store_si128(reinterpret_cast<__m128i*>(state.s0), lo0);
+    _mm_store_si128(reinterpret_cast<__m128i*>(state.s0 + 2), hi0);
+    _mm_store_si128(reinterpret_cast<__m128i*>(state.s1), lo1);
+    _mm_store_si128(reinterpret_cast<__m128i*>(state.s1 + 2), hi1);
+}
+
+#if defined(__GNUC__)
+__attribute__((target("avx2")))
+inline void noise_blocks_avx2(uint8_t* dst, int blocks, NoiseState& state) {
+    __m256i s0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(state.s0));
+    __m256i s1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(state.s1));
+    for (int i = 0; i < blocks; i++) {
+        __m256i a = s0;
+        __m256i b = s1;
+        a = _mm256_xor_si256(a, _mm256_slli_epi64(a, 23));
+        s0 = b;
+        s1 = _mm256_xor_si256(_mm256_xor_si256(a, b), _mm256_xor_si256(_mm256_srli_epi64(a, 17), _mm256_srli_epi64(b, 26)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 32), _mm256_add_epi64(s1, b));
+    }
+    _mm256_store_si256(reinterpret_cast<__m256i*>(state.s0), s0);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(state.s1), s1);
+}
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+inline uint64x2_t xorshift128plus_neon(uint64x2_t& s0, uint64x2_t& s1) {
+    uint64x2_t a = s0;
+    uint64x2_t b = s1;
+    a = veorq_u64(a, vshlq_n_u64(a, 23));
+    s0 = b;
+    s1 = veorq_u64(veorq_u64(a, b), veorq_u64(vshrq_n_u64(a, 17), vshrq_n_u64(b, 26)));
+    return vaddq_u64(s1, b);
+}
+
+inline void noise_blocks_neon(uint8_t* dst, int blocks, NoiseState& state) {
+    uint64x2_t lo0 = vld1q_u64(state.s0);
+    uint64x2_t hi0 = vld1q_u64(state.s0 + 2);
+    uint64x2_t lo1 = vld1q_u64(state.s1);
+    uint64x2_t hi1 = vld1q_u64(state.s1 + 2);
+    for (int i = 0; i < blocks; i++) {
+        vst1q_u8(dst + i * 32, vreinterpretq_u8_u64(xorshift128plus_neon(lo0, lo1)));
+        vst1q_u8(dst + i * 32 + 16, vreinterpretq_u8_u64(xorshift128plus_neon(hi0, hi1)));
+    }
+    vst1q_u64(state.s0, lo0);
+    vst1q_u64(state.s0 + 2, hi0);
+    vst1q_u64(state.s1, lo1);
+    vst1q_u64(state.s1 + 2, hi1);
+}
+#endif
+
+// One zone plate row: 126.5 + sx[x] * cy + cx[x] * sy, truncated to 8 bits
+using ZoneRowFunction = void (*)(uint8_t* dst, const float* sx, const float* cx, float cy, float sy, int width);
+
+inline void zone_row_scalar(uint8_t* dst, const float* sx, const float* cx, float cy, float sy, int width) {
+    for (int x = 0; x < width; x++) {
+        dst[x] = static_cast<uint8_t>(126.5f + sx[x] * cy + cx[x] * sy);
+    }
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+inline __m128i zone_quad_sse2(const float* sx, const float* cx, __m128 cy, __m128 sy, __m128 bias) {
+    __m128 value = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(sx), cy), _mm_mul_ps(_mm_loadu_ps(cx), sy));
+    return _mm_cvttps_epi32(_mm_add_ps(value, bias));
+}
+
+inline void zone_row_sse2(uint8_t* dst, const float* sx, const float* cx, float cy, float sy, int width) {
+    __m128 vcy = _mm_set1_ps(cy);
+    __m128 vsy = _mm_set1_ps(sy);
+    __m128 bias = _mm_set1_ps(126.5f);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i a = _mm_packs_epi32(zone_quad_sse2(sx + x, cx + x, vcy, vsy, bias),
+                                    zone_quad_sse2(sx + x + 4, cx + x + 4, vcy, vsy, bias));
+        __m128i b = _mm_packs_epi32(zone_quad_sse2(sx + x + 8, cx + x + 8, vcy, vsy, bias),
+                                    zone_quad_sse2(sx + x + 12, cx + x + 12, vcy, vsy, bias));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(a, b));
+    }
+    zone_row_scalar(dst + x, sx + x, cx + x, cy, sy, width - x);
+}
+#elif defined(__aarch64__) || defined(_M_ARM64)
+inline void zone_row_neon(uint8_t* dst, const float* sx, const float* cx, float cy, float sy, int width) {
+    float32x4_t bias = vdupq_n_f32(126.5f);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        float32x4_t lo = vmlaq_n_f32(vmlaq_n_f32(bias, vld1q_f32(sx + x), cy), vld1q_f32(cx + x), sy);
+        float32x4_t hi = vmlaq_n_f32(vmlaq_n_f32(bias, vld1q_f32(sx + x + 4), cy), vld1q_f32(cx + x + 4), sy);
+        uint16x8_t wide = vcombine_u16(vmovn_u32(vcvtq_u32_f32(lo)), vmovn_u32(vcvtq_u32_f32(hi)));
+        vst1_u8(dst + x, vmovn_u16(wide));
+    }
+    zone_row_scalar(dst + x, sx + x, cx + x, cy, sy, width - x);
+}
+#endif
+
+inline ZoneRowFunction select_zone_row() {
+#if defined(__x86_64__) || defined(_M_X64)
+    return zone_row_sse2;
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    return zone_row_neon;
+#else
+    return zone_row_scalar;
+#endif
+}
+
+// Pick the widest noise kernel the CPU supports
+inline NoiseBlockFunction select_noise_blocks(const char*& name) {
+#if defined(__x86_64__) || defined(_M_X64)
+#if defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2")) {
+        name = "avx2";
+        return noise_blocks_avx2;
+    }
+#endif
+    name = "sse2";
+    return noise_blocks_sse2;
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    name = "neon";
+    return noise_blocks_neon;
+#else
+    name = "scalar";
+    return noise_blocks_scalar;
+#endif
+}
+
+class PatternGenerator {
+private:
+    TestPattern pattern;
+    int width;
+    int height;
+    int chroma_width;
+    int chroma_height;
+    
+    // Constant rows: the gradient ramp, and one luma/chroma row of the bars
+    std::vector<uint8_t> ramp;
+    std::vector<uint8_t> bars_y;
+    std::vector<uint8_t> bars_u;
+    std::vector<uint8_t> bars_v;
+    
+    // Zone plate: sin(px + py + t) = sin(px) cos(py + t) + cos(px) sin(py + t)
+    std::vector<float> sine_x;
+    std::vector<float> cosine_x;
+    std::vector<double> phase_y;
+    
+    NoiseBlockFunction noise_blocks;
+    ZoneRowFunction zone_row;
+    const char* noise_kernel = "scalar";
+    
+    // Frame buffers (plane pointers) whose constant planes are already written
+    std::vector<std::array<uint8_t*, 3>> prepared;
+    
+public:
+    PatternGenerator(TestPattern test_pattern, int frame_width, int frame_height)
+        : pattern(test_pattern), width(frame_width), height(frame_height),
+          chroma_width((frame_width + 1) / 2), chroma_height((frame_height + 1) / 2) {
+        noise_blocks = select_noise_blocks(noise_kernel);
+        zone_row = select_zone_row();
+        
+        switch (pattern) {
+            case TestPattern::Gradient:
+                // Row y of frame i is ramp[(y + i * 5) % 256 ...]
+                ramp.resize(width + 256);
+                for (size_t x = 0; x < ramp.size(); x++) {
+                    ramp[x] = x & 255;
+                }
+                break;
+            case TestPattern::Bars: {
+                // White, yellow, cyan, green, magenta, red, blue
+                static const uint8_t colors[7][3] = {
+                    {180, 128, 128}, {162, 44, 142}, {131, 156, 44}, {112, 72, 58},
+                    {84, 184, 198}, {65, 100, 212}, {35, 212, 114}
+                };
+                bars_y.resize(width);
+                bars_u.resize(chroma_width);
+                bars_v.resize(chroma_width);
+                for (int x = 0; x < width; x++) {
+                    bars_y[x] = colors[x * 7 / width][0];
+                }
+                for (int x = 0; x < chroma_width; x++) {
+                    int bar = std::min(x * 2, width - 1) * 7 / width;
+                    bars_u[x] = colors[bar][1];
+                    bars_v[x] = colors[bar][2];
+                }
+                break;
+            }
+            case TestPattern::ZonePlate: {
+                // Phase grows with r^2 and reaches Nyquist at half the larger dimension
+                double scale = 3.14159265358979323846 / std::max(1, std::max(width, height));
+                sine_x.resize(width);
+                cosine_x.resize(width);
+                phase_y.resize(height);
+                for (int x = 0; x < width; x++) {
+                    double dx = x - width / 2;
+                    sine_x[x] = static_cast<float>(109 * std::sin(scale * dx * dx));
+                    cosine_x[x] = static_cast<float>(109 * std::cos(scale * dx * dx));
+                }
+                for (int y = 0; y < height; y++) {
+                    double dy = y - height / 2;
+                    phase_y[y] = scale * dy * dy;
+                }
+                break;
+            }
+            case TestPattern::Noise:
+                break;
+        }
+    }
+    
+    TestPattern get_pattern() const { return pattern; }
+    
+    // SIMD kernel used for the noise pattern (the zone plate uses sse2/neon)
+    const char* kernel_name() const { return noise_kernel; }
+    
+    // Draw frame `index` into a writable YUV420P frame of the generator's size.
+    // Constant planes are skipped for buffers that were filled before; that
+    // holds for a frame reused in place, a copy made by av_frame_make_writable
+    // and buffers recycled through a pool. Call reset() if buffers are
+    // filled with anything else in between.
+    void fill(AVFrame* frame, int64_t index) {
+        bool ready = is_prepared(frame);
+        
+        switch (pattern) {
+            case TestPattern::Gradient:
+                fill_gradient(frame, index);
+                break;
+            case TestPattern::Bars:
+                if (!ready) {
+                    fill_rows(frame->data[0], frame->linesize[0], bars_y.data(), width, height);
+                }
+                break;
+            case TestPattern::Noise:
+                fill_noise(frame, index);
+                break;
+            case TestPattern::ZonePlate:
+                fill_zone_plate(frame, index);
+                break;
+        }
+        
+        if (!ready) {
+            if (pattern == TestPattern::Bars) {
+                fill_rows(frame->data[1], frame->linesize[1], bars_u.data(), chroma_width, chroma_height);
+                fill_rows(frame->data[2], frame->linesize[2], bars_v.data(), chroma_width, chroma_height);
+            } else {
+                fill_plane(frame->data[1], frame->linesize[1], 128, chroma_width, chroma_height);
+                fill_plane(frame->data[2], frame->linesize[2], 128, chroma_width, chroma_height);
+            }
+            mark_prepared(frame);
+        }
+    }
+    
+    // Forget which buffers hold the constant planes
+    void reset() {
+        prepared.clear();
+    }
+    
+private:
+    bool is_prepared(const AVFrame* frame) const {
+        for (const auto& planes : prepared) {
+            if (planes[0] == frame->data[0] && planes[1] == frame->data[1] && planes[2] == frame->data[2]) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    void mark_prepared(const AVFrame* frame) {
+        // Pools are small; a long list means buffers are not being reused
+        if (prepared.size() >= 64) {
+            prepared.clear();
+        }
+        prepared.push_back({frame->data[0], frame->data[1], frame->data[2]});
+    }
+    
+    static void fill_plane(uint8_t* data, int linesize, uint8_t value, int plane_width, int plane_height) {
+        if (linesize == plane_width) {
+            std::memset(data, value, static_cast<size_t>(plane_width) * plane_height);
+            return;
+        }
+        for (int y = 0; y < plane_height; y++) {
+            std::memset(data + static_cast<ptrdiff_t>(y) * linesize, value, plane_width);
+        }
+    }
+    
+    static void fill_rows(uint8_t* data, int linesize, const uint8_t* row, int plane_width, int plane_height) {
+        for (int y = 0; y < plane_height; y++) {
+            std::memcpy(data + static_cast<ptrdiff_t>(y) * linesize, row, plane_width);
+        }
+    }
+    
+    void fill_gradient(AVFrame* frame, int64_t index) {
+        int offset = static_cast<int>((index * 5) & 255);
+        for (int y = 0; y < height; y++) {
+            std::memcpy(frame->data[0] + static_cast<ptrdiff_t>(y) * frame->linesize[0],
+                        ramp.data() + ((y + offset) & 255), width);
+        }
+    }
+    
+    void fill_noise(AVFrame* frame, int64_t index) {
+        // Seed from the frame index so every frame is reproducible
+        NoiseState state;
+        uint64_t seed = static_cast<uint64_t>(index) * 0x9E3779B97F4A7C15ull;
+        for (int lane = 0; lane < 4; lane++) {
+            state.s0[lane] = splitmix64(seed);
+            state.s1[lane] = splitmix64(seed);
+        }
+        
+        int blocks = width / 32;
+        int tail = width % 32;
+        for (int y = 0; y < height; y++) {
+            uint8_t* row = frame->data[0] + static_cast<ptrdiff_t>(y) * frame->linesize[0];
+            noise_blocks(row, blocks, state);
+            if (tail > 0) {
+                uint8_t last[32];
+                noise_blocks_scalar(last, 1, state);
+                std::memcpy(row + blocks * 32, last, tail);
+            }
+        }
+    }
+    
+    void fill_zone_plate(AVFrame* frame, int64_t index) {
+        double drift = 2 * 3.14159265358979323846 * (index % 32) / 32;
+        for (int y = 0; y < height; y++) {
+            uint8_t* row = frame->data[0] + static_cast<ptrdiff_t>(y) * frame->linesize[0];
+            float cy = static_cast<float>(std::cos(phase_y[y] + drift));
+            float sy = static_cast<float>(std::sin(phase_y[y] + drift));
+            zone_row(row, sine_x.data(), cosine_x.data(), cy, sy, width);
+        }
+    }
+    
+    static uint64_t splitmix64(uint64_t& seed) {
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+};
+
+#endif // PATTERN_GENERATOR_H
@@ -0,0 +1,338 @@
+// Objective quality of decoded YUV420P frames against their source:
+// PSNR per plane from the sum of squared errors, and luma SSIM computed the
+// x264/FFmpeg way on 8x8 windows stepped by 4 pixels.
+//
+// Both inner loops have SIMD kernels (SSE2/AVX2 on x86-64, NEON on ARM64)
+// picked at construction, so a full frame is scored in a fraction of the
+// time the encoder spends on it.
+#ifndef QUALITY_METER_H
+#define QUALITY_METER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+struct QualityScores {
+    double psnr_y = 0.0;
+    double psnr_u = 0.0;
+    double psnr_v = 0.0;
+    double psnr = 0.0;      // All planes, weighted by sample count (4:1:1)
+    double ssim_y = 0.0;
+};
+
+// Sum of squared differences over one row
+using RowSseFunction = uint64_t (*)(const uint8_t* a, const uint8_t* b, int width);
+
+inline uint64_t row_sse_scalar(const uint8_t* a, const uint8_t* b, int width) {
+    uint32_t sse = 0;
+    for (int x = 0; x < width; x++) {
+        int diff = a[x] - b[x];
+        sse += diff * diff;
+    }
+    return sse;
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+inline uint64_t row_sse_sse2(const uint8_t* a, const uint8_t* b, int width) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i sum = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+        __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+        __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+        sum = _mm_add_epi32(sum, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(sum)) + row_sse_scalar(a + x, b + x, width - x);
+}
+
+// MSVC has no per-function target attribute; the AVX2 kernel is GCC/Clang only
+// and select_quality_kernels() only picks it there
+#if defined(__GNUC__)
+__attribute__((target("avx2")))
+inline uint64_t row_sse_avx2(const uint8_t* a, const uint8_t* b, int width) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i sum = _mm256_setzero_si256();
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + x));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + x));
+        __m256i lo = _mm256_sub_epi16(_mm256_unpacklo_epi8(va, zero), _mm256_unpacklo_epi8(vb, zero));
+        __m256i hi = _mm256_sub_epi16(_mm256_unpackhi_epi8(va, zero), _mm256_unpackhi_epi8(vb, zero));
+        sum = _mm256_add_epi32(sum, _mm256_add_epi32(_mm256_madd_epi16(lo, lo), _mm256_madd_epi16(hi, hi)));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(half)) + row_sse_sse2(a + x, b + x, width - x);
+}
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+inline uint64_t row_sse_neon(const uint8_t* a, const uint8_t* b, int width) {
+    uint32x4_t sum = vdupq_n_u32(0);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16_t diff = vabdq_u8(vld1q_u8(a + x), vld1q_u8(b + x));
+        sum = vpadalq_u16(sum, vmull_u8(vget_low_u8(diff), vget_low_u8(diff)));
+        sum = vpadalq_u16(sum, vmull_u8(vget_high_u8(diff), vget_high_u8(diff)));
+    }
+    return vaddvq_u32(sum) + row_sse_scalar(a + x, b + x, width - x);
+}
+#endif
+
+inline uint64_t plane_sse(RowSseFunction row_sse, const uint8_t* a, int a_stride, const uint8_t* b, int b_stride,
+                          int width, int height) {
+    uint64_t sse = 0;
+    for (int y = 0; y < height; y++) {
+        sse += row_sse(a + static_cast<ptrdiff_t>(y) * a_stride, b + static_cast<ptrdiff_t>(y) * b_stride, width);
+    }
+    return sse;
+}
+
+// Identical planes are capped at 100 dB instead of infinity
+inline double psnr_from_sse(uint64_t sse, uint64_t samples) {
+    if (sse == 0 || samples == 0) {
+        return 100.0;
+    }
+    return std::min(100.0, 10.0 * std::log10(255.0 * 255.0 * samples / sse));
+}
+
+// Sums over one 4x4 block: s1 = sum a, s2 = sum b, ss = sum a^2 + b^2, s12 = sum a*b
+struct SsimSums {
+    int s1;
+    int s2;
+    int ss;
+    int s12;
+};
+
+// Sums of `blocks` horizontally adjacent 4x4 blocks
+using SsimBlockFunction = void (*)(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride, int blocks, SsimSums* sums);
+
+inline void ssim_block_sums_scalar(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride, int blocks, SsimSums* sums) {
+    for (int block = 0; block < blocks; block++) {
+        SsimSums sum = {0, 0, 0, 0};
+        for (int y = 0; y < 4; y++) {
+            const uint8_t* row_a = a + static_cast<ptrdiff_t>(y) * a_stride + block * 4;
+            const uint8_t* row_b = b + static_cast<ptrdiff_t>(y) * b_stride + block * 4;
+            for (int x = 0; x < 4; x++) {
+                sum.s1 += row_a[x];
+                sum.s2 += row_b[x];
+                sum.ss += row_a[x] * row_a[x] + row_b[x] * row_b[x];
+                sum.s12 += row_a[x] * row_b[x];
+            }
+        }
+        sums[block] = sum;
+    }
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+// Two blocks per iteration: each 32-bit lane holds the sums of two columns,
+// lanes 0-1 belong to the first block and lanes 2-3 to the second
+inline void ssim_block_sums_sse2(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride, int blocks, SsimSums* sums) {
+    static_assert(sizeof(SsimSums) == 16, "SsimSums is stored as one vector");
+    __m128i zero = _mm_setzero_si128();
+    __m128i ones = _mm_set1_epi16(1);
+    int block = 0;
+    for (; block + 2 <= blocks; block += 2) {
+        __m128i s1 = zero;
+        __m128i s2 = zero;
+        __m128i ss = zero;
+        __m128i s12 = zero;
+        for (int y = 0; y < 4; y++) {
+            const uint8_t* row_a = a + static_cast<ptrdiff_t>(y) * a_stride + block * 4;
+            const uint8_t* row_b = b + static_cast<ptrdiff_t>(y) * b_stride + block * 4;
+            __m128i va = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row_a)), zero);
+            __m128i vb = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row_b)), zero);
+            s1 = _mm_add_epi32(s1, _mm_madd_epi16(va, ones));
+            s2 = _mm_add_epi32(s2, _mm_madd_epi16(vb, ones));
+            ss = _mm_add_epi32(ss, _mm_add_epi32(_mm_madd_epi16(va, va), _mm_madd_epi16(vb, vb)));
+            s12 = _mm_add_epi32(s12, _mm_madd_epi16(va, vb));
+        }
+        // Fold the column pairs into lanes 0 and 2, then transpose into two SsimSums
+        s1 = _mm_add_epi32(s1, _mm_srli_epi64(s1, 32));
+        s2 = _mm_add_epi32(s2, _mm_srli_epi64(s2, 32));
+        ss = _mm_add_epi32(ss, _mm_srli_epi64(ss, 32));
+        s12 = _mm_add_epi32(s12, _mm_srli_epi64(s12, 32));
+        __m128i means_lo = _mm_unpacklo_epi32(s1, s2);
+        __m128i means_hi = _mm_unpackhi_epi32(s1, s2);
+        __m128i products_lo = _mm_unpacklo_epi32(ss, s12);
+        __m128i products_hi = _mm_unpackhi_epi32(ss, s12);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + block), _mm_unpacklo_epi64(means_lo, products_lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + block + 1), _mm_unpacklo_epi64(means_hi, products_hi));
+    }
+    ssim_block_sums_scalar(a + block * 4, a_stride, b + block * 4, b_stride, blocks - block, sums + block);
+}
+#elif defined(__aarch64__) || defined(_M_ARM64)
+inline void ssim_block_sums_neon(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride, int blocks, SsimSums* sums) {
+    int block = 0;
+    for (; block + 2 <= blocks; block += 2) {
+        uint16x8_t s1 = vdupq_n_u16(0);
+        uint16x8_t s2 = vdupq_n_u16(0);
+        uint32x4_t ss_lo = vdupq_n_u32(0);
+        uint32x4_t ss_hi = vdupq_n_u32(0);
+        uint32x4_t s12_lo = vdupq_n_u32(0);
+        uint32x4_t s12_hi = vdupq_n_u32(0);
+        for (int y = 0; y < 4; y++) {
+            uint8x8_t va = vld1_u8(a + static_cast<ptrdiff_t>(y) * a_stride + block * 4);
+            uint8x8_t vb = vld1_u8(b + static_cast<ptrdiff_t>(y) * b_stride + block * 4);
+            uint16x8_t aa = vmull_u8(va, va);
+            uint16x8_t bb = vmull_u8(vb, vb);
+            uint16x8_t ab = vmull_u8(va, vb);
+            s1 = vaddw_u8(s1, va);
+            s2 = vaddw_u8(s2, vb);
+            ss_lo = vaddq_u32(ss_lo, vaddl_u16(vget_low_u16(aa), vget_low_u16(bb)));
+            ss_hi = vaddq_u32(ss_hi, vaddl_u16(vget_high_u16(aa), vget_high_u16(bb)));
+            s12_lo = vaddw_u16(s12_lo, vget_low_u16(ab));
+            s12_hi = vaddw_u16(s12_hi, vget_high_u16(ab));
+        }
+        sums[block] = {vaddv_u16(vget_low_u16(s1)), vaddv_u16(vget_low_u16(s2)),
+                       static_cast<int>(vaddvq_u32(ss_lo)), static_cast<int>(vaddvq_u32(s12_lo))};
+        sums[block + 1] = {vaddv_u16(vget_high_u16(s1)), vaddv_u16(vget_high_u16(s2)),
+                           static_cast<int>(vaddvq_u32(ss_hi)), static_cast<int>(vaddvq_u32(s12_hi))};
+    }
+    ssim_block_sums_scalar(a + block * 4, a_stride, b + block * 4, b_stride, blocks - block, sums + block);
+}
+#endif
+
+// SSIM of one 8x8 window from its four block sums (x264's ssim_end1)
+inline double ssim_window(int64_t s1, int64_t s2, int64_t ss, int64_t s12) {
+    const double c1 = 416;       // .01^2 * 255^2 * 64
+    const double c2 = 235963;    // .03^2 * 255^2 * 64 * 63
+    int64_t vars = ss * 64 - s1 * s1 - s2 * s2;
+    int64_t covar = s12 * 64 - s1 * s2;
+    return (2.0 * s1 * s2 + c1) * (2.0 * covar + c2) / ((static_cast<double>(s1 * s1 + s2 * s2) + c1) * (vars + c2));
+}
+
+inline double plane_ssim(SsimBlockFunction block_sums, const uint8_t* a, int a_stride, const uint8_t* b, int b_stride, int width, int height) {
+    int blocks_x = width / 4;
+    int blocks_y = height / 4;
+    if (blocks_x < 2 || blocks_y < 2) {
+        return 1.0;
+    }
+    
+    // Block sums of the previous and current block row
+    std::vector<SsimSums> previous(blocks_x);
+    std::vector<SsimSums> current(blocks_x);
+    block_sums(a, a_stride, b, b_stride, blocks_x, previous.data());
+    
+    double total = 0.0;
+    for (int by = 1; by < blocks_y; by++) {
+        block_sums(a + static_cast<ptrdiff_t>(by) * 4 * a_stride, a_stride,
+                   b + static_cast<ptrdiff_t>(by) * 4 * b_stride, b_stride, blocks_x, current.data());
+        for (int bx = 0; bx + 1 < blocks_x; bx++) {
+            const SsimSums& p0 = previous[bx];
+            const SsimSums& p1 = previous[bx + 1];
+            const SsimSums& c0 = current[bx];
+            const SsimSums& c1 = current[bx + 1];
+            total += ssim_window(p0.s1 + p1.s1 + c0.s1 + c1.s1, p0.s2 + p1.s2 + c0.s2 + c1.s2,
+                                 p0.ss + p1.ss + c0.ss + c1.ss, p0.s12 + p1.s12 + c0.s12 + c1.s12);
+        }
+        previous.swap(current);
+    }
+    return total / (static_cast<double>(blocks_x - 1) * (blocks_y - 1));
+}
+
+struct QualityKernels {
+    RowSseFunction row_sse;
+    SsimBlockFunction ssim_blocks;
+    const char* name;
+};
+
+// Pick the widest kernels the CPU supports
+inline QualityKernels select_quality_kernels() {
+#if defined(__x86_64__) || defined(_M_X64)
+#if defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2")) {
+        return {row_sse_avx2, ssim_block_sums_sse2, "avx2"};
+    }
+#endif
+    return {row_sse_sse2, ssim_block_sums_sse2, "sse2"};
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    return {row_sse_neon, ssim_block_sums_neon, "neon"};
+#else
+    return {row_sse_scalar, ssim_block_sums_scalar, "scalar"};
+#endif
+}
+
+// Accumulates per-frame scores; average() is the mean over all measured frames
+class QualityMeter {
+public:
+    QualityMeter() : kernels(select_quality_kernels()) {}
+    
+    // Both frames are YUV420P of the same size
+    QualityScores measure(const AVFrame* source, const AVFrame* decoded) {
+        int width = source->width;
+        int height = source->height;
+        int chroma_width = (width + 1) / 2;
+        int chroma_height = (height + 1) / 2;
+        uint64_t luma_samples = static_cast<uint64_t>(width) * height;
+        uint64_t chroma_samples = static_cast<uint64_t>(chroma_width) * chroma_height;
+        
+        uint64_t sse[3];
+        for (int plane = 0; plane < 3; plane++) {
+            sse[plane] = plane_sse(kernels.row_sse, source->data[plane], source->linesize[plane], decoded->data[plane], decoded->linesize[plane],
+                                   plane == 0 ? width : chroma_width, plane == 0 ? height : chroma_height);
+        }
+        
+        QualityScores scores;
+        scores.psnr_y = psnr_from_sse(sse[0], luma_samples);
+        scores.psnr_u = psnr_from_sse(sse[1], chroma_samples);
+        scores.psnr_v = psnr_from_sse(sse[2], chroma_samples);
+        scores.psnr = psnr_from_sse(sse[0] + sse[1] + sse[2], luma_samples + 2 * chroma_samples);
+        scores.ssim_y = plane_ssim(kernels.ssim_blocks, source->data[0], source->linesize[0], decoded->data[0], decoded->linesize[0], width, height);
+        
+        sum.psnr_y += scores.psnr_y;
+        sum.psnr_u += scores.psnr_u;
+        sum.psnr_v += scores.psnr_v;
+        sum.psnr += scores.psnr;
+        sum.ssim_y += scores.ssim_y;
+        frames++;
+        return scores;
+    }
+    
+    QualityScores average() const {
+        QualityScores mean;
+        if (frames > 0) {
+            mean.psnr_y = sum.psnr_y / frames;
+            mean.psnr_u = sum.psnr_u / frames;
+            mean.psnr_v = sum.psnr_v / frames;
+            mean.psnr = sum.psnr / frames;
+            mean.ssim_y = sum.ssim_y / frames;
+        }
+        return mean;
+    }
+    
+    // Adds another meter's frames, e.g. one per encoder segment
+    void merge(const QualityMeter& other) {
+        sum.psnr_y += other.sum.psnr_y;
+        sum.psnr_u += other.sum.psnr_u;
+        sum.psnr_v += other.sum.psnr_v;
+        sum.psnr += other.sum.psnr;
+        sum.ssim_y += other.sum.ssim_y;
+        frames += other.frames;
+    }
+    
+    int64_t frame_count() const { return frames; }
+    const char* kernel_name() const { return kernels.name; }
+    
+private:
+    QualityKernels kernels;
+    QualityScores sum;
+    int64_t frames = 0;
+};
+
+#endif // QUALITY_METER_H
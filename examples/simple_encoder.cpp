@@ -1,4 +1,24 @@
 #include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -6,236 +26,1285 @@ extern "C" {
 #include <libavutil/avutil.h>
 #include <libavutil/opt.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/parseutils.h>
 }
 
-int main(int argc, char* argv[]) {
-    if (argc != 5) {
-        std::cerr << "Usage: " << argv[0] << " <width> <height> <frame_count> <output_file>" << std::endl;
-        std::cerr << "Example: " << argv[0] << " 640 480 30 test_output.mp4" << std::endl;
-        return 1;
+#include "encoder_profile.h"
+#include "frame_pool.h"
+#include "pattern_generator.h"
+#include "quality_meter.h"
+
+// Fixed-capacity blocking queue between the reader thread and the encoder
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t queue_capacity) : capacity(queue_capacity) {}
+    
+    // Returns false once the queue is closed
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this] { return items.size() < capacity || closed; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
     }
     
-    int width = std::atoi(argv[1]);
-    int height = std::atoi(argv[2]);
-    int frame_count = std::atoi(argv[3]);
-    const char* output_filename = argv[4];
+    // Returns false when the queue is closed and fully drained
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this] { return !items.empty() || closed; });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
     
-    if (width <= 0 || height <= 0 || frame_count <= 0) {
-        std::cerr << "Width, height, and frame count must be positive" << std::endl;
-        return 1;
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+        not_full.notify_all();
     }
     
-    AVFormatContext* format_ctx = nullptr;
-    AVCodecContext* codec_ctx = nullptr;
-    AVStream* stream = nullptr;
-    AVFrame* frame = nullptr;
-    AVPacket* packet = nullptr;
+private:
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+};
+
+enum class InputFormat { Y4m, Raw };
+
+// YUV420P frames from a Y4M or raw file (or stdin). A reader thread reads into
+// pool frames up to `read_ahead` frames ahead of the encoder, so reading the
+// next frames overlaps encoding the current one.
+class FrameReader {
+public:
+    static constexpr int read_ahead = 3;
     
-    // Allocate output format context
-    int ret = avformat_alloc_output_context2(&format_ctx, nullptr, nullptr, output_filename);
-    if (ret < 0) {
-        char error_buf[AV_ERROR_MAX_STRING_SIZE];
-        av_strerror(ret, error_buf, AV_ERROR_MAX_STRING_SIZE);
-        std::cerr << "Could not create output context: " << error_buf << std::endl;
-        return 1;
+    ~FrameReader() {
+        stop();
+        if (file && file != stdin) {
+            fclose(file);
+        }
     }
     
-    // Find H.264 encoder
-    const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_H264);
-    if (!codec) {
-        std::cerr << "H.264 encoder not found" << std::endl;
-        goto cleanup;
+    // Y4M input takes size and frame rate from its header; raw input uses the given ones
+    bool open(const std::string& input_path, InputFormat input_format, int raw_width, int raw_height, AVRational raw_rate) {
+        path = input_path;
+        format = input_format;
+        if (path == "-") {
+#ifdef _WIN32
+            _setmode(_fileno(stdin), _O_BINARY);
+#endif
+            file = stdin;
+        } else {
+            file = fopen(path.c_str(), "rb");
+            if (!file) {
+                std::cerr << "Could not open input: " << path << std::endl;
+                return false;
+            }
+        }
+        // Whole-frame reads either way; a larger stdio buffer cuts read syscalls
+        setvbuf(file, nullptr, _IOFBF, 1 << 20);
+        
+        width = raw_width;
+        height = raw_height;
+        frame_rate = raw_rate;
+        if (format == InputFormat::Y4m && !read_y4m_header()) {
+            return false;
+        }
+        if (width <= 0 || height <= 0 || frame_rate.num <= 0 || frame_rate.den <= 0) {
+            std::cerr << "Invalid input size or frame rate" << std::endl;
+            return false;
+        }
+        return true;
     }
     
-    // Create new stream
-    stream = avformat_new_stream(format_ctx, nullptr);
-    if (!stream) {
-        std::cerr << "Could not create new stream" << std::endl;
-        goto cleanup;
+    // Starts reading up to max_frames frames (0 = until end of input)
+    void start(FramePool& pool, int max_frames) {
+        worker = std::thread([this, &pool, max_frames] { read_frames(pool, max_frames); });
     }
     
-    // Allocate codec context
-    codec_ctx = avcodec_alloc_context3(codec);
-    if (!codec_ctx) {
-        std::cerr << "Could not allocate codec context" << std::endl;
-        goto cleanup;
+    // Moves the next frame into `frame`; false at end of input or on error
+    bool next(AVFrame* frame) {
+        AVFrame* input = nullptr;
+        auto wait_start = std::chrono::steady_clock::now();
+        bool ok = ring.pop(input);
+        encoder_wait += std::chrono::duration<double>(std::chrono::steady_clock::now() - wait_start).count();
+        if (!ok) {
+            return false;
+        }
+        av_frame_unref(frame);
+        av_frame_move_ref(frame, input);
+        av_frame_free(&input);
+        return true;
+    }
+    
+    // Stops the reader and frees frames still in the ring
+    void stop() {
+        ring.close();
+        if (worker.joinable()) {
+            worker.join();
+        }
+        AVFrame* input = nullptr;
+        while (ring.pop(input)) {
+            av_frame_free(&input);
+        }
     }
     
-    // Set codec parameters
-    codec_ctx->bit_rate = 400000;
-    codec_ctx->width = width;
-    codec_ctx->height = height;
-    codec_ctx->time_base = {1, 25}; // 25 FPS
-    codec_ctx->framerate = {25, 1};
-    codec_ctx->gop_size = 10;
-    codec_ctx->max_b_frames = 1;
-    codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    bool failed() const { return error; }
+    int get_width() const { return width; }
+    int get_height() const { return height; }
+    AVRational get_frame_rate() const { return frame_rate; }
+    const std::string& get_path() const { return path; }
+    InputFormat get_format() const { return format; }
     
-    // Some formats want stream headers to be separate
-    if (format_ctx->oformat->flags & AVFMT_GLOBALHEADER) {
-        codec_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    void print_stats() const {
+        std::cout << "Input: " << frames_read << " frames read, reader waited " << std::setprecision(3)
+                  << reader_wait << " s for free buffers, encoder waited " << encoder_wait << " s for input" << std::endl;
     }
     
-    // Open codec
-    ret = avcodec_open2(codec_ctx, codec, nullptr);
-    if (ret < 0) {
-        char error_buf[AV_ERROR_MAX_STRING_SIZE];
-        av_strerror(ret, error_buf, AV_ERROR_MAX_STRING_SIZE);
-        std::cerr << "Could not open codec: " << error_buf << std::endl;
-        goto cleanup;
+private:
+    // "YUV4MPEG2 W640 H480 F25:1 Ip A1:1 C420jpeg"
+    bool read_y4m_header() {
+        std::string line;
+        if (!read_line(line) || line.compare(0, 10, "YUV4MPEG2 ") != 0) {
+            std::cerr << path << ": not a Y4M stream" << std::endl;
+            return false;
+        }
+        size_t pos = 10;
+        while (pos < line.size()) {
+            size_t end = line.find(' ', pos);
+            if (end == std::string::npos) {
+                end = line.size();
+            }
+            std::string token = line.substr(pos, end - pos);
+            pos = end + 1;
+            if (token.empty()) {
+                continue;
+            }
+            const char* value = token.c_str() + 1;
+            switch (token[0]) {
+                case 'W':
+                    width = std::atoi(value);
+                    break;
+                case 'H':
+                    height = std::atoi(value);
+                    break;
+                case 'F':
+                    if (sscanf(value, "%d:%d", &frame_rate.num, &frame_rate.den) != 2) {
+                        std::cerr << path << ": invalid Y4M frame rate " << value << std::endl;
+                        return false;
+                    }
+                    break;
+                case 'C':
+                    if (strcmp(value, "420") != 0 && strcmp(value, "420jpeg") != 0 &&
+                        strcmp(value, "420mpeg2") != 0 && strcmp(value, "420paldv") != 0) {
+                        std::cerr << path << ": unsupported Y4M colorspace " << value << " (only 4:2:0)" << std::endl;
+                        return false;
+                    }
+                    break;
+                default:
+                    // Interlacing, aspect ratio and extensions do not affect the data
+                    break;
+            }
+        }
+        return true;
     }
     
-    // Copy codec parameters to stream
-    ret = avcodec_parameters_from_context(stream->codecpar, codec_ctx);
-    if (ret < 0) {
-        std::cerr << "Could not copy codec parameters" << std::endl;
-        goto cleanup;
+    bool read_line(std::string& line) {
+        line.clear();
+        int c;
+        while ((c = fgetc(file)) != EOF && c != '\n') {
+            if (line.size() > 1024) {
+                return false;
+            }
+            line.push_back(static_cast<char>(c));
+        }
+        return c == '\n';
     }
     
-    // Open output file
-    if (!(format_ctx->oformat->flags & AVFMT_NOFILE)) {
-        ret = avio_open(&format_ctx->pb, output_filename, AVIO_FLAG_WRITE);
-        if (ret < 0) {
-            char error_buf[AV_ERROR_MAX_STRING_SIZE];
-            av_strerror(ret, error_buf, AV_ERROR_MAX_STRING_SIZE);
-            std::cerr << "Could not open output file: " << error_buf << std::endl;
-            goto cleanup;
+    // Reads one frame; a clean end of input before the frame is not an error
+    bool read_frame(AVFrame* frame, bool& end) {
+        end = false;
+        if (format == InputFormat::Y4m) {
+            std::string line;
+            if (!read_line(line)) {
+                end = line.empty() && feof(file);
+                if (!end) {
+                    std::cerr << path << ": invalid Y4M frame header" << std::endl;
+                }
+                return false;
+            }
+            if (line.compare(0, 5, "FRAME") != 0) {
+                std::cerr << path << ": invalid Y4M frame header" << std::endl;
+                return false;
+            }
         }
+        
+        for (int plane = 0; plane < 3; plane++) {
+            int plane_width = plane == 0 ? width : (width + 1) / 2;
+            int plane_height = plane == 0 ? height : (height + 1) / 2;
+            for (int y = 0; y < plane_height; y++) {
+                uint8_t* row = frame->data[plane] + static_cast<ptrdiff_t>(y) * frame->linesize[plane];
+                size_t got = fread(row, 1, plane_width, file);
+                if (got != static_cast<size_t>(plane_width)) {
+                    end = format == InputFormat::Raw && plane == 0 && y == 0 && got == 0 && feof(file);
+                    if (!end) {
+                        std::cerr << path << ": truncated frame " << frames_read << std::endl;
+                    }
+                    return false;
+                }
+            }
+        }
+        return true;
     }
     
-    // Write file header
-    ret = avformat_write_header(format_ctx, nullptr);
-    if (ret < 0) {
-        char error_buf[AV_ERROR_MAX_STRING_SIZE];
-        av_strerror(ret, error_buf, AV_ERROR_MAX_STRING_SIZE);
-        std::cerr << "Error writing header: " << error_buf << std::endl;
-        goto cleanup;
+    void read_frames(FramePool& pool, int max_frames) {
+        while (max_frames == 0 || frames_read < max_frames) {
+            AVFrame* frame = av_frame_alloc();
+            if (!frame || !pool.get(frame)) {
+                std::cerr << "Could not allocate input frame" << std::endl;
+                av_frame_free(&frame);
+                error = true;
+                break;
+            }
+            
+            bool end = false;
+            if (!read_frame(frame, end)) {
+                av_frame_free(&frame);
+                error = !end;
+                break;
+            }
+            frames_read++;
+            
+            auto wait_start = std::chrono::steady_clock::now();
+            bool pushed = ring.push(frame);
+            reader_wait += std::chrono::duration<double>(std::chrono::steady_clock::now() - wait_start).count();
+            if (!pushed) {
+                av_frame_free(&frame);
+                break;
+            }
+        }
+        ring.close();
+    }
+    
+    std::string path;
+    InputFormat format = InputFormat::Y4m;
+    FILE* file = nullptr;
+    int width = 0;
+    int height = 0;
+    AVRational frame_rate = {25, 1};
+    
+    BoundedQueue<AVFrame*> ring{read_ahead};
+    std::thread worker;
+    std::atomic<bool> error{false};
+    int frames_read = 0;
+    double reader_wait = 0.0;
+    double encoder_wait = 0.0;
+};
+
+// Scores the encoder's output against its source frames on a separate thread.
+// The encode loop only hands over references: each source frame before it is
+// encoded, then each packet, or the reconstructed frame for encoders that
+// export it (AV_CODEC_CAP_ENCODER_RECON_FRAME). Packets are decoded by the
+// monitor's own decoder, and each output frame is measured against the source
+// frame with the same pts.
+class QualityMonitor {
+public:
+    static constexpr size_t queue_depth = 16;
+    
+    struct FrameScore {
+        int64_t frame;
+        QualityScores scores;
+    };
+    
+    ~QualityMonitor() {
+        queue.close();
+        if (worker.joinable()) {
+            worker.join();
+        }
+        for (auto& entry : sources) {
+            av_frame_free(&entry.second);
+        }
+        avcodec_free_context(&decoder_ctx);
+        av_frame_free(&output);
+        av_frame_free(&planar);
+    }
+    
+    // Asks for reconstructed frames when the encoder can export them; call before opening it
+    static void request_recon_frames(AVCodecContext* codec_ctx, const AVCodec* codec) {
+        if (codec->capabilities & AV_CODEC_CAP_ENCODER_RECON_FRAME) {
+            codec_ctx->flags |= AV_CODEC_FLAG_RECON_FRAME;
+        }
+    }
+    
+    // Opens a decoder for the opened encoder's output unless it exports reconstructed frames
+    bool start(const AVCodecContext* codec_ctx) {
+        output = av_frame_alloc();
+        if (!output) {
+            std::cerr << "Could not allocate frame" << std::endl;
+            return false;
+        }
+        use_recon = (codec_ctx->flags & AV_CODEC_FLAG_RECON_FRAME) != 0;
+        if (!use_recon && !open_decoder(codec_ctx)) {
+            return false;
+        }
+        worker = std::thread([this] { run(); });
+        return true;
+    }
+    
+    // Keeps a reference to a source frame until its encoded version is scored
+    bool add_source(const AVFrame* frame) {
+        QualityItem item;
+        item.frame = av_frame_clone(frame);
+        item.source = true;
+        if (!item.frame) {
+            std::cerr << "Could not allocate frame" << std::endl;
+            return false;
+        }
+        return push(item);
     }
     
-    // Allocate frame
-    frame = av_frame_alloc();
-    if (!frame) {
-        std::cerr << "Could not allocate frame" << std::endl;
-        goto cleanup;
+    // Queues a packet just received from the encoder, or the reconstructed frame that goes with it
+    bool add_output(AVCodecContext* codec_ctx, const AVPacket* packet) {
+        QualityItem item;
+        if (use_recon) {
+            item.frame = av_frame_alloc();
+            if (!item.frame || avcodec_receive_frame(codec_ctx, item.frame) < 0) {
+                std::cerr << "Could not get reconstructed frame" << std::endl;
+                av_frame_free(&item.frame);
+                return false;
+            }
+            // The reconstructed frame belongs to the packet just received
+            item.frame->pts = packet->pts;
+        } else {
+            item.packet = av_packet_clone(packet);
+            if (!item.packet) {
+                std::cerr << "Could not allocate packet" << std::endl;
+                return false;
+            }
+        }
+        return push(item);
     }
     
-    frame->format = codec_ctx->pix_fmt;
-    frame->width = codec_ctx->width;
-    frame->height = codec_ctx->height;
+    // Waits for every queued item to be scored; false if the monitor failed
+    bool finish() {
+        queue.close();
+        if (worker.joinable()) {
+            auto drain_start = std::chrono::steady_clock::now();
+            worker.join();
+            drain_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - drain_start).count();
+            if (!error && !sources.empty()) {
+                std::cerr << "Quality: " << sources.size() << " frames were never scored" << std::endl;
+                error = true;
+            }
+        }
+        return !error;
+    }
+    
+    bool failed() const { return error; }
+    bool uses_reconstructed_frames() const { return use_recon; }
+    const QualityMeter& get_meter() const { return meter; }
+    const std::vector<FrameScore>& get_frame_scores() const { return frame_scores; }
+    double get_queue_wait() const { return queue_wait; }
+    double get_drain_time() const { return drain_time; }
     
-    ret = av_frame_get_buffer(frame, 0);
-    if (ret < 0) {
-        std::cerr << "Could not allocate frame buffer" << std::endl;
-        goto cleanup;
+private:
+    struct QualityItem {
+        AVFrame* frame = nullptr;
+        AVPacket* packet = nullptr;
+        bool source = false;
+    };
+    
+    bool open_decoder(const AVCodecContext* codec_ctx) {
+        const AVCodec* decoder = avcodec_find_decoder(codec_ctx->codec_id);
+        if (!decoder) {
+            std::cerr << "Quality: no decoder for " << avcodec_get_name(codec_ctx->codec_id) << std::endl;
+            return false;
+        }
+        decoder_ctx = avcodec_alloc_context3(decoder);
+        AVCodecParameters* parameters = avcodec_parameters_alloc();
+        bool ok = decoder_ctx && parameters && avcodec_parameters_from_context(parameters, codec_ctx) >= 0 &&
+                  avcodec_parameters_to_context(decoder_ctx, parameters) >= 0;
+        avcodec_parameters_free(&parameters);
+        if (!ok || avcodec_open2(decoder_ctx, decoder, nullptr) < 0) {
+            std::cerr << "Quality: could not open " << decoder->name << " decoder" << std::endl;
+            return false;
+        }
+        return true;
     }
     
-    packet = av_packet_alloc();
-    if (!packet) {
-        std::cerr << "Could not allocate packet" << std::endl;
-        goto cleanup;
+    // A full queue means the monitor is behind; the encode loop waits here.
+    // Fails once the monitor has reported an error, which stops the encode
+    bool push(QualityItem& item) {
+        if (error) {
+            av_frame_free(&item.frame);
+            av_packet_free(&item.packet);
+            return false;
+        }
+        auto wait_start = std::chrono::steady_clock::now();
+        bool pushed = queue.push(item);
+        queue_wait += std::chrono::duration<double>(std::chrono::steady_clock::now() - wait_start).count();
+        if (!pushed) {
+            av_frame_free(&item.frame);
+            av_packet_free(&item.packet);
+        }
+        return pushed;
     }
     
-    std::cout << "Creating " << frame_count << " frames of " << width << "x" << height << " video..." << std::endl;
+    void run() {
+        QualityItem item;
+        while (queue.pop(item)) {
+            // After an error the queue is still drained so the encoder never blocks
+            if (item.source && !error) {
+                sources[item.frame->pts] = item.frame;
+                item.frame = nullptr;
+            } else if (item.frame && !error) {
+                score(item.frame);
+            } else if (item.packet && !error) {
+                decode(item.packet);
+            }
+            av_frame_free(&item.frame);
+            av_packet_free(&item.packet);
+        }
+        if (decoder_ctx && !error) {
+            decode(nullptr);
+        }
+    }
     
-    // Generate frames
-    for (int i = 0; i < frame_count; i++) {
-        ret = av_frame_make_writable(frame);
+    // Sends one packet (nullptr flushes) and scores every frame it produces
+    void decode(const AVPacket* packet) {
+        if (avcodec_send_packet(decoder_ctx, packet) < 0) {
+            std::cerr << "Quality: error decoding encoder output" << std::endl;
+            error = true;
+            return;
+        }
+        while (!error) {
+            int ret = avcodec_receive_frame(decoder_ctx, output);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+                return;
+            } else if (ret < 0) {
+                std::cerr << "Quality: error decoding encoder output" << std::endl;
+                error = true;
+                return;
+            }
+            score(output);
+            av_frame_unref(output);
+        }
+    }
+    
+    void score(const AVFrame* frame) {
+        auto entry = sources.find(frame->pts);
+        if (entry == sources.end()) {
+            std::cerr << "Quality: no source frame for pts " << frame->pts << std::endl;
+            error = true;
+            return;
+        }
+        AVFrame* source = entry->second;
+        if (frame->format == AV_PIX_FMT_NV12 && source->format == AV_PIX_FMT_YUV420P) {
+            frame = deinterleave_chroma(frame);
+        }
+        if (!frame || frame->format != source->format || frame->width != source->width || frame->height != source->height) {
+            std::cerr << "Quality: encoder output is not in the source format" << std::endl;
+            error = true;
+            return;
+        }
+        frame_scores.push_back({source->pts, meter.measure(source, frame)});
+        av_frame_free(&source);
+        sources.erase(entry);
+    }
+    
+    // Reconstructed frames may come in the encoder's internal layout
+    // (NV12 for libx264); split the chroma into the source's U and V planes
+    const AVFrame* deinterleave_chroma(const AVFrame* frame) {
+        if (!planar || planar->width != frame->width || planar->height != frame->height) {
+            av_frame_free(&planar);
+            planar = av_frame_alloc();
+            if (!planar) {
+                return nullptr;
+            }
+            planar->format = AV_PIX_FMT_YUV420P;
+            planar->width = frame->width;
+            planar->height = frame->height;
+            if (av_frame_get_buffer(planar, 0) < 0) {
+                av_frame_free(&planar);
+                return nullptr;
+            }
+        }
+        
+        int chroma_width = (frame->width + 1) / 2;
+        int chroma_height = (frame->height + 1) / 2;
+        av_image_copy_plane(planar->data[0], planar->linesize[0], frame->data[0], frame->linesize[0], frame->width, frame->height);
+        for (int y = 0; y < chroma_height; y++) {
+            const uint8_t* uv = frame->data[1] + static_cast<ptrdiff_t>(y) * frame->linesize[1];
+            uint8_t* u = planar->data[1] + static_cast<ptrdiff_t>(y) * planar->linesize[1];
+            uint8_t* v = planar->data[2] + static_cast<ptrdiff_t>(y) * planar->linesize[2];
+            for (int x = 0; x < chroma_width; x++) {
+                u[x] = uv[2 * x];
+                v[x] = uv[2 * x + 1];
+            }
+        }
+        return planar;
+    }
+    
+    BoundedQueue<QualityItem> queue{queue_depth};
+    std::thread worker;
+    std::atomic<bool> error{false};
+    bool use_recon = false;
+    AVCodecContext* decoder_ctx = nullptr;
+    AVFrame* output = nullptr;
+    AVFrame* planar = nullptr;
+    std::map<int64_t, AVFrame*> sources;
+    QualityMeter meter;
+    std::vector<FrameScore> frame_scores;
+    double queue_wait = 0.0;
+    double drain_time = 0.0;
+};
+
+// One encoder instance over a range of frames. Each segment gets a fresh
+// encoder, so it starts with an IDR frame and no GOP refers across segment
+// boundaries; in chunked mode its packets are kept until it is muxed.
+struct EncodeSegment {
+    AVCodecContext* codec_ctx = nullptr;
+    int first_frame = 0;
+    int frame_count = 0;
+    FramePool frame_pool;
+    std::unique_ptr<QualityMonitor> quality;    // Holds pool frames, so it goes before the pool
+    std::vector<AVPacket*> packets;
+    double generate_time = 0.0;
+    const char* kernel = "";
+    bool ok = false;
+    
+    ~EncodeSegment() {
+        for (AVPacket*& packet : packets) {
+            av_packet_free(&packet);
+        }
+        avcodec_free_context(&codec_ctx);
+    }
+};
+
+class SimpleEncoder {
+private:
+    EncoderProfile profile;
+    TestPattern pattern;
+    FrameReader* reader;
+    AVRational frame_rate = {25, 1};
+    AVFormatContext* format_ctx = nullptr;
+    AVStream* stream = nullptr;
+    const AVCodec* codec = nullptr;
+    std::vector<std::unique_ptr<EncodeSegment>> segments;
+    int total_frames = 0;
+    bool measure_quality = false;
+    std::string quality_log_path;
+    
+    int64_t output_bytes = 0;
+    int64_t last_dts = AV_NOPTS_VALUE;
+    
+public:
+    // With an input reader its frames are encoded instead of the test pattern
+    SimpleEncoder(const EncoderProfile& encoder_profile, TestPattern test_pattern, FrameReader* input = nullptr)
+        : profile(encoder_profile), pattern(test_pattern), reader(input) {}
+    
+    ~SimpleEncoder() {
+        cleanup();
+    }
+    
+    // Scores every encoded frame against its source while encoding; with a
+    // log path the per-frame scores are also written as CSV. Call before open()
+    void enable_quality_meter(const std::string& log_path) {
+        measure_quality = true;
+        quality_log_path = log_path;
+    }
+    
+    // With chunks > 1 the frames are split into up to `chunks` segments whose
+    // length is a multiple of the GOP, each encoded by its own encoder. With an
+    // input reader frame_count is a limit (0 = whole input)
+    bool open(int width, int height, int frame_count, int chunks, const char* output_filename) {
+        total_frames = frame_count;
+        if (reader) {
+            frame_rate = reader->get_frame_rate();
+        }
+        
+        // Allocate output format context
+        int ret = avformat_alloc_output_context2(&format_ctx, nullptr, nullptr, output_filename);
         if (ret < 0) {
-            std::cerr << "Could not make frame writable" << std::endl;
-            break;
+            print_error("Could not create output context", ret);
+            return false;
+        }
+        
+        // Find the profile's encoder (H.264 by default)
+        codec = find_profile_encoder(profile);
+        if (!codec) {
+            std::cerr << (profile.codec.empty() ? "H.264" : profile.codec) << " encoder not found" << std::endl;
+            return false;
+        }
+        
+        // Create new stream
+        stream = avformat_new_stream(format_ctx, nullptr);
+        if (!stream) {
+            std::cerr << "Could not create new stream" << std::endl;
+            return false;
+        }
+        
+        // Split into GOP-aligned segments so keyframes land where a single
+        // encoder would put them
+        int segment_frames = (frame_count + chunks - 1) / chunks;
+        if (chunks > 1 && profile.gop > 0) {
+            segment_frames = (segment_frames + profile.gop - 1) / profile.gop * profile.gop;
+        }
+        if (reader) {
+            auto segment = std::make_unique<EncodeSegment>();
+            segment->frame_count = frame_count;
+            segments.push_back(std::move(segment));
+        }
+        for (int first = 0; !reader && first < frame_count; first += segment_frames) {
+            auto segment = std::make_unique<EncodeSegment>();
+            segment->first_frame = first;
+            segment->frame_count = std::min(segment_frames, frame_count - first);
+            segments.push_back(std::move(segment));
         }
         
-        // Generate a simple pattern (moving gradient)
-        for (int y = 0; y < height; y++) {
-            for (int x = 0; x < width; x++) {
-                // Create a moving pattern
-                int value = (x + y + i * 5) % 256;
-                frame->data[0][y * frame->linesize[0] + x] = value; // Y
+        // Parallel encoders share the cores unless the profile fixes a thread count
+        int threads = profile.threads;
+        if (segments.size() > 1 && threads == 0) {
+            threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency() / segments.size()));
+        }
+        for (auto& segment : segments) {
+            if (!open_encoder(*segment, width, height, threads)) {
+                return false;
             }
         }
         
-        // Fill UV planes with neutral values (gray)
-        for (int y = 0; y < height / 2; y++) {
-            for (int x = 0; x < width / 2; x++) {
-                frame->data[1][y * frame->linesize[1] + x] = 128; // U
-                frame->data[2][y * frame->linesize[2] + x] = 128; // V
+        // Stream copy needs every segment to share the stream header (SPS/PPS)
+        const AVCodecContext* first_ctx = segments.front()->codec_ctx;
+        for (const auto& segment : segments) {
+            const AVCodecContext* ctx = segment->codec_ctx;
+            if (ctx->extradata_size != first_ctx->extradata_size ||
+                (ctx->extradata_size > 0 && memcmp(ctx->extradata, first_ctx->extradata, ctx->extradata_size) != 0)) {
+                std::cerr << "Segment encoders produced different stream headers; "
+                          << codec->name << " cannot be used for chunked encoding" << std::endl;
+                return false;
+            }
+            // Each encoder shifts DTS back by its reorder delay; segments only
+            // join into one DTS sequence (with dts <= pts) if the delays match
+            if (ctx->delay != first_ctx->delay || ctx->has_b_frames != first_ctx->has_b_frames) {
+                std::cerr << "Segment encoders use different reorder delays; "
+                          << codec->name << " cannot be used for chunked encoding" << std::endl;
+                return false;
             }
         }
         
-        frame->pts = i;
+        // Copy codec parameters to stream
+        ret = avcodec_parameters_from_context(stream->codecpar, first_ctx);
+        if (ret < 0) {
+            std::cerr << "Could not copy codec parameters" << std::endl;
+            return false;
+        }
         
-        // Encode frame
-        ret = avcodec_send_frame(codec_ctx, frame);
+        // Open output file
+        if (!(format_ctx->oformat->flags & AVFMT_NOFILE)) {
+            ret = avio_open(&format_ctx->pb, output_filename, AVIO_FLAG_WRITE);
+            if (ret < 0) {
+                print_error("Could not open output file", ret);
+                return false;
+            }
+        }
+        
+        // Write file header
+        ret = avformat_write_header(format_ctx, nullptr);
         if (ret < 0) {
-            std::cerr << "Error sending frame to encoder" << std::endl;
-            break;
+            print_error("Error writing header", ret);
+            return false;
         }
         
-        while (ret >= 0) {
-            ret = avcodec_receive_packet(codec_ctx, packet);
-            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-                break;
-            } else if (ret < 0) {
-                std::cerr << "Error during encoding" << std::endl;
-                goto encode_cleanup;
+        std::cout << "Encoder: " << codec->name << std::endl;
+        std::cout << "Profile: ";
+        print_encoder_profile(profile);
+        if (segments.size() > 1) {
+            std::cout << "Chunked encode: " << segments.size() << " segments of up to " << segment_frames
+                      << " frames, threads per encoder: " << (threads > 0 ? std::to_string(threads) : "auto") << std::endl;
+        }
+        return true;
+    }
+    
+    bool encode() {
+        int width = segments.front()->codec_ctx->width;
+        int height = segments.front()->codec_ctx->height;
+        if (reader) {
+            std::cout << "Encoding " << width << "x" << height << " "
+                      << (reader->get_format() == InputFormat::Y4m ? "Y4M" : "raw YUV420P") << " input from "
+                      << (reader->get_path() == "-" ? "stdin" : reader->get_path()) << "..." << std::endl;
+        } else {
+            std::cout << "Creating " << total_frames << " frames of " << width << "x" << height << " video ("
+                      << test_pattern_name(pattern) << " pattern)..." << std::endl;
+        }
+        
+        auto start_time = std::chrono::steady_clock::now();
+        
+        if (reader) {
+            // Frames come from the reader thread; the segment's pool feeds its ring
+            EncodeSegment& segment = *segments.front();
+            reader->start(segment.frame_pool, segment.frame_count);
+            bool ok = encode_segment(segment, true);
+            reader->stop();
+            if (!ok || reader->failed()) {
+                return false;
+            }
+            total_frames = segment.frame_count;
+            if (total_frames == 0) {
+                std::cerr << "No frames in input" << std::endl;
+                return false;
+            }
+        } else if (segments.size() == 1) {
+            // Single encoder: packets go straight to the muxer
+            if (!encode_segment(*segments.front(), true)) {
+                return false;
+            }
+        } else {
+            // Segments encode in parallel and are muxed in order as they finish.
+            // Their packets already carry global timestamps, so this is a stream copy
+            std::vector<std::thread> workers;
+            for (auto& segment : segments) {
+                EncodeSegment* job = segment.get();
+                workers.emplace_back([this, job] { job->ok = encode_segment(*job, false); });
             }
             
-            // Rescale packet timestamp
-            av_packet_rescale_ts(packet, codec_ctx->time_base, stream->time_base);
-            packet->stream_index = stream->index;
+            bool ok = true;
+            for (size_t i = 0; i < segments.size(); i++) {
+                workers[i].join();
+                EncodeSegment& segment = *segments[i];
+                if (!ok || !segment.ok) {
+                    ok = false;
+                    continue;
+                }
+                for (AVPacket* packet : segment.packets) {
+                    if (!write_packet(packet, segment.codec_ctx->time_base)) {
+                        ok = false;
+                        break;
+                    }
+                }
+                std::cout << "Segment " << (i + 1) << "/" << segments.size() << ": frames " << segment.first_frame
+                          << "-" << (segment.first_frame + segment.frame_count - 1) << ", "
+                          << segment.packets.size() << " packets" << std::endl;
+                for (AVPacket*& packet : segment.packets) {
+                    av_packet_free(&packet);
+                }
+                segment.packets.clear();
+            }
+            if (!ok) {
+                return false;
+            }
+        }
+        
+        // Write file trailer
+        int ret = av_write_trailer(format_ctx);
+        if (ret < 0) {
+            print_error("Error writing trailer", ret);
+            return false;
+        }
+        
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        double duration = total_frames * av_q2d(segments.front()->codec_ctx->time_base);
+        
+        double generate_time = 0.0;
+        int64_t allocations = 0;
+        int64_t reserved = 0;
+        for (const auto& segment : segments) {
+            generate_time += segment->generate_time;
+            allocations += segment->frame_pool.allocation_count();
+            reserved += segment->frame_pool.reserved_count();
+        }
+        
+        std::cout << "\nEncoding complete!" << std::endl;
+        std::cout << "Encode time: " << std::fixed << std::setprecision(3) << elapsed << " seconds" << std::endl;
+        std::cout << "Encode speed: " << std::setprecision(1) << total_frames / elapsed << " fps ("
+                  << std::setprecision(2) << duration / elapsed << "x realtime)" << std::endl;
+        if (reader) {
+            reader->print_stats();
+        } else {
+            std::cout << "Pattern generation: " << std::setprecision(3) << generate_time << " seconds ("
+                      << std::setprecision(1) << 100.0 * generate_time / (elapsed * segments.size()) << "% of encode time";
+            if (segments.size() > 1) {
+                std::cout << " across " << segments.size() << " encoders";
+            }
+            if (pattern == TestPattern::Noise) {
+                std::cout << ", " << segments.front()->kernel;
+            }
+            std::cout << ")" << std::endl;
+        }
+        std::cout << "Frame buffers: " << allocations << " allocated for " << total_frames
+                  << " frames (" << reserved << " at startup, " << allocations - reserved << " while encoding)" << std::endl;
+        std::cout << "Output bitrate: " << std::setprecision(1)
+                  << output_bytes * 8 / duration / 1000 << " kb/s (" << output_bytes << " bytes)" << std::endl;
+        if (measure_quality) {
+            return print_quality();
+        }
+        return true;
+    }
+    
+private:
+    bool open_encoder(EncodeSegment& segment, int width, int height, int threads) {
+        // Allocate codec context
+        segment.codec_ctx = avcodec_alloc_context3(codec);
+        AVCodecContext* codec_ctx = segment.codec_ctx;
+        if (!codec_ctx) {
+            std::cerr << "Could not allocate codec context" << std::endl;
+            return false;
+        }
+        
+        // Set codec parameters; rate control, GOP and threading come from the profile
+        codec_ctx->width = width;
+        codec_ctx->height = height;
+        codec_ctx->time_base = av_inv_q(frame_rate); // 25 FPS unless the input says otherwise
+        codec_ctx->framerate = frame_rate;
+        codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+        
+        AVDictionary* options = nullptr;
+        configure_encoder(codec_ctx, profile, &options);
+        codec_ctx->thread_count = threads;
+        
+        // Segments are concatenated, so no GOP may reference a previous one
+        if (segments.size() > 1) {
+            codec_ctx->flags |= AV_CODEC_FLAG_CLOSED_GOP;
+        }
+        
+        if (measure_quality) {
+            QualityMonitor::request_recon_frames(codec_ctx, codec);
+        }
+        
+        // Some formats want stream headers to be separate
+        if (format_ctx->oformat->flags & AVFMT_GLOBALHEADER) {
+            codec_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+        
+        // Open codec
+        int ret = avcodec_open2(codec_ctx, codec, &options);
+        bool options_ok = ret >= 0 && check_unused_encoder_options(options, profile, codec->name);
+        av_dict_free(&options);
+        if (ret < 0) {
+            print_error("Could not open codec", ret);
+            return false;
+        }
+        if (!options_ok) {
+            return false;
+        }
+        
+        // Frame buffers come from the pool. The encoder may hold up to
+        // `delay` frames (lookahead, B-frames) besides the one being drawn;
+        // the input reader adds its ring plus the frame it is reading
+        int reserve = std::max(codec_ctx->delay, codec_ctx->max_b_frames) + 2;
+        if (reader) {
+            reserve += FrameReader::read_ahead + 1;
+        }
+        // The quality monitor keeps sources until their encoded frame is scored
+        if (measure_quality) {
+            reserve += QualityMonitor::queue_depth;
+        }
+        if (!segment.frame_pool.init(codec_ctx->pix_fmt, width, height, reserve)) {
+            std::cerr << "Could not allocate frame buffers" << std::endl;
+            return false;
+        }
+        
+        if (measure_quality) {
+            segment.quality = std::make_unique<QualityMonitor>();
+            if (!segment.quality->start(codec_ctx)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // Encode the segment's frames; packets are muxed directly or kept in the segment
+    bool encode_segment(EncodeSegment& segment, bool mux) {
+        AVCodecContext* codec_ctx = segment.codec_ctx;
+        AVFrame* frame = av_frame_alloc();
+        AVPacket* packet = av_packet_alloc();
+        if (!frame || !packet) {
+            std::cerr << "Could not allocate frame" << std::endl;
+            av_frame_free(&frame);
+            av_packet_free(&packet);
+            return false;
+        }
+        
+        PatternGenerator generator(pattern, codec_ctx->width, codec_ctx->height);
+        segment.kernel = generator.kernel_name();
+        
+        bool ok = true;
+        int i = 0;
+        for (; (reader || i < segment.frame_count) && ok; i++) {
+            int number = segment.first_frame + i;
             
-            // Write packet
-            ret = av_interleaved_write_frame(format_ctx, packet);
-            if (ret < 0) {
-                char error_buf[AV_ERROR_MAX_STRING_SIZE];
-                av_strerror(ret, error_buf, AV_ERROR_MAX_STRING_SIZE);
-                std::cerr << "Error writing packet: " << error_buf << std::endl;
-                goto encode_cleanup;
+            if (reader) {
+                // Next frame read ahead by the reader thread
+                if (!reader->next(frame)) {
+                    break;
+                }
+            } else {
+                // Take a buffer the encoder is not using; the previous one stays
+                // referenced by the encoder until it is done with it
+                if (!segment.frame_pool.get(frame)) {
+                    std::cerr << "Could not get frame buffer" << std::endl;
+                    ok = false;
+                    break;
+                }
+                
+                // Draw the test pattern; constant planes are only written once per buffer
+                auto generate_start = std::chrono::steady_clock::now();
+                generator.fill(frame, number);
+                segment.generate_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - generate_start).count();
+            }
+            
+            // Global frame numbers, so chunked packets need no timestamp rewrite
+            frame->pts = number;
+            
+            if (segment.quality && !segment.quality->add_source(frame)) {
+                ok = false;
+                break;
             }
             
-            av_packet_unref(packet);
+            // Encode frame
+            ok = encode_frame(segment, frame, packet, mux);
+            
+            if (mux && (number + 1) % 10 == 0) {
+                if (reader) {
+                    std::cout << "Encoded " << (number + 1) << " frames" << std::endl;
+                } else {
+                    std::cout << "Encoded " << (number + 1) << "/" << total_frames << " frames" << std::endl;
+                }
+            }
+        }
+        if (reader) {
+            segment.frame_count = i;
+        }
+        
+        // Flush encoder
+        if (ok) {
+            ok = encode_frame(segment, nullptr, packet, mux);
         }
         
-        if ((i + 1) % 10 == 0) {
-            std::cout << "Encoded " << (i + 1) << "/" << frame_count << " frames" << std::endl;
+        // Wait for the monitor to score the last frames
+        if (ok && segment.quality) {
+            ok = segment.quality->finish();
         }
+        
+        av_frame_free(&frame);
+        av_packet_free(&packet);
+        return ok;
     }
     
-    // Flush encoder
-    ret = avcodec_send_frame(codec_ctx, nullptr);
-    if (ret >= 0) {
-        while (ret >= 0) {
-            ret = avcodec_receive_packet(codec_ctx, packet);
+    // Send one frame (nullptr flushes) and mux or keep every packet it produces
+    bool encode_frame(EncodeSegment& segment, const AVFrame* input, AVPacket* packet, bool mux) {
+        int ret = avcodec_send_frame(segment.codec_ctx, input);
+        if (ret < 0) {
+            std::cerr << "Error sending frame to encoder" << std::endl;
+            return false;
+        }
+        
+        while (true) {
+            ret = avcodec_receive_packet(segment.codec_ctx, packet);
             if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-                break;
+                return true;
             } else if (ret < 0) {
-                break;
+                std::cerr << "Error during encoding" << std::endl;
+                return false;
             }
             
-            av_packet_rescale_ts(packet, codec_ctx->time_base, stream->time_base);
-            packet->stream_index = stream->index;
-            av_interleaved_write_frame(format_ctx, packet);
-            av_packet_unref(packet);
+            // Before muxing, which rescales the timestamps
+            if (segment.quality && !segment.quality->add_output(segment.codec_ctx, packet)) {
+                return false;
+            }
+            
+            if (mux) {
+                if (!write_packet(packet, segment.codec_ctx->time_base)) {
+                    return false;
+                }
+            } else {
+                AVPacket* kept = av_packet_alloc();
+                if (!kept) {
+                    std::cerr << "Could not allocate packet" << std::endl;
+                    return false;
+                }
+                av_packet_move_ref(kept, packet);
+                segment.packets.push_back(kept);
+            }
         }
     }
     
-    // Write file trailer
-    av_write_trailer(format_ctx);
+    // Quality summary over all segments, and the per-frame log if requested
+    bool print_quality() {
+        QualityMeter total;
+        std::vector<QualityMonitor::FrameScore> frame_scores;
+        double queue_wait = 0.0;
+        double drain_time = 0.0;
+        for (const auto& segment : segments) {
+            const QualityMonitor& monitor = *segment->quality;
+            total.merge(monitor.get_meter());
+            frame_scores.insert(frame_scores.end(), monitor.get_frame_scores().begin(), monitor.get_frame_scores().end());
+            queue_wait += monitor.get_queue_wait();
+            drain_time += monitor.get_drain_time();
+        }
+        std::sort(frame_scores.begin(), frame_scores.end(),
+                  [](const QualityMonitor::FrameScore& a, const QualityMonitor::FrameScore& b) { return a.frame < b.frame; });
+        if (frame_scores.empty()) {
+            return true;
+        }
+        
+        QualityScores mean = total.average();
+        auto worst = std::min_element(frame_scores.begin(), frame_scores.end(),
+                                      [](const QualityMonitor::FrameScore& a, const QualityMonitor::FrameScore& b) {
+                                          return a.scores.psnr_y < b.scores.psnr_y;
+                                      });
+        std::cout << "Quality (" << (segments.front()->quality->uses_reconstructed_frames() ? "reconstructed frames" : "decoded output")
+                  << ", " << total.kernel_name() << "): PSNR Y " << std::setprecision(2) << mean.psnr_y << " U " << mean.psnr_u
+                  << " V " << mean.psnr_v << " dB, overall " << mean.psnr << " dB, SSIM Y " << std::setprecision(4) << mean.ssim_y << std::endl;
+        std::cout << "Worst frame: " << worst->frame << " (PSNR Y " << std::setprecision(2) << worst->scores.psnr_y
+                  << " dB, SSIM Y " << std::setprecision(4) << worst->scores.ssim_y << ")" << std::endl;
+        std::cout << "Quality meter: encoder waited " << std::setprecision(3) << queue_wait << " s on the meter queue, "
+                  << drain_time << " s for the meter to finish" << std::endl;
+        
+        if (quality_log_path.empty()) {
+            return true;
+        }
+        std::ofstream log(quality_log_path);
+        if (!log) {
+            std::cerr << "Could not open quality log: " << quality_log_path << std::endl;
+            return false;
+        }
+        log << "frame,psnr_y,psnr_u,psnr_v,psnr,ssim_y" << std::endl;
+        log << std::fixed;
+        for (const QualityMonitor::FrameScore& entry : frame_scores) {
+            log << entry.frame << "," << std::setprecision(3) << entry.scores.psnr_y << "," << entry.scores.psnr_u << ","
+                << entry.scores.psnr_v << "," << entry.scores.psnr << "," << std::setprecision(5) << entry.scores.ssim_y << "\n";
+        }
+        std::cout << "Per-frame quality written to " << quality_log_path << std::endl;
+        return true;
+    }
     
-    std::cout << "Video created successfully: " << output_filename << std::endl;
+    bool write_packet(AVPacket* packet, AVRational time_base) {
+        // Segment encoders share one reorder delay (checked in open), so their
+        // DTS sequences line up; still keep DTS strictly increasing at the joins
+        if (packet->dts != AV_NOPTS_VALUE) {
+            if (last_dts != AV_NOPTS_VALUE && packet->dts <= last_dts) {
+                packet->dts = last_dts + 1;
+            }
+            last_dts = packet->dts;
+        }
+        
+        // Rescale packet timestamp
+        av_packet_rescale_ts(packet, time_base, stream->time_base);
+        packet->stream_index = stream->index;
+        output_bytes += packet->size;
+        
+        // Write packet
+        int ret = av_interleaved_write_frame(format_ctx, packet);
+        if (ret < 0) {
+            print_error("Error writing packet", ret);
+            return false;
+        }
+        return true;
+    }
     
-encode_cleanup:
-    if (packet) av_packet_free(&packet);
-    if (frame) av_frame_free(&frame);
+    void cleanup() {
+        segments.clear();
+        if (format_ctx) {
+            if (!(format_ctx->oformat->flags & AVFMT_NOFILE)) {
+                avio_closep(&format_ctx->pb);
+            }
+            avformat_free_context(format_ctx);
+            format_ctx = nullptr;
+        }
+    }
     
-cleanup:
-    if (codec_ctx) avcodec_free_context(&codec_ctx);
-    if (format_ctx) {
-        if (!(format_ctx->oformat->flags & AVFMT_NOFILE)) {
-            avio_closep(&format_ctx->pb);
+    void print_error(const char* message, int error_code) {
+        char error_buf[AV_ERROR_MAX_STRING_SIZE];
+        av_strerror(error_code, error_buf, AV_ERROR_MAX_STRING_SIZE);
+        std::cerr << message << ": " << error_buf << std::endl;
+    }
+};
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <width> <height> <frame_count> <output_file>" << std::endl;
+    std::cerr << "       " << program << " [options] --input <file|-> <output_file>" << std::endl;
+    std::cerr << "Example: " << program << " 640 480 30 test_output.mp4" << std::endl;
+    std::cerr << "         producer | " << program << " --input - output.mp4" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --config <file>        Load encoding profiles (see encoder_profiles.conf)" << std::endl;
+    std::cerr << "  --profile <name>       Profile to use (default: first profile in the file)" << std::endl;
+    std::cerr << "  --list-profiles        Print the profiles in the config file and exit" << std::endl;
+    std::cerr << "  --pattern <name>       Test pattern: gradient (default), bars, noise, zoneplate" << std::endl;
+    std::cerr << "  --chunks <n>           Encode n GOP-aligned segments in parallel and join them" << std::endl;
+    std::cerr << "  --input <file|->       Encode YUV420P frames from a Y4M or raw file, '-' for stdin" << std::endl;
+    std::cerr << "  --input-format <fmt>   y4m (default) or yuv (raw, .yuv files are detected)" << std::endl;
+    std::cerr << "  --size <WxH>           Frame size of raw input" << std::endl;
+    std::cerr << "  --fps <rate>           Frame rate of raw input (default: 25)" << std::endl;
+    std::cerr << "  --frames <n>           Encode at most n input frames" << std::endl;
+    std::cerr << "  --quality              Measure PSNR/SSIM of every encoded frame while encoding" << std::endl;
+    std::cerr << "  --quality-log <file>   Also write the per-frame scores as CSV (implies --quality)" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<const char*> positional;
+    std::string config_path;
+    std::string profile_name;
+    bool list_profiles = false;
+    TestPattern pattern = TestPattern::Gradient;
+    int chunks = 1;
+    std::string input_path;
+    std::string input_format_name;
+    int raw_width = 0;
+    int raw_height = 0;
+    AVRational raw_rate = {25, 1};
+    int max_frames = 0;
+    bool quality = false;
+    std::string quality_log_path;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--config" && i + 1 < argc) {
+            config_path = argv[++i];
+        } else if (arg == "--profile" && i + 1 < argc) {
+            profile_name = argv[++i];
+        } else if (arg == "--list-profiles") {
+            list_profiles = true;
+        } else if (arg == "--chunks" && i + 1 < argc) {
+            chunks = std::atoi(argv[++i]);
+            if (chunks <= 0) {
+                std::cerr << "--chunks must be positive" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--input" && i + 1 < argc) {
+            input_path = argv[++i];
+        } else if (arg == "--input-format" && i + 1 < argc) {
+            input_format_name = argv[++i];
+        } else if (arg == "--size" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &raw_width, &raw_height) != 2 || raw_width <= 0 || raw_height <= 0) {
+                std::cerr << "Invalid size: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--fps" && i + 1 < argc) {
+            if (av_parse_video_rate(&raw_rate, argv[++i]) < 0) {
+                std::cerr << "Invalid frame rate: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--frames" && i + 1 < argc) {
+            max_frames = std::atoi(argv[++i]);
+            if (max_frames <= 0) {
+                std::cerr << "--frames must be positive" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--quality") {
+            quality = true;
+        } else if (arg == "--quality-log" && i + 1 < argc) {
+            quality = true;
+            quality_log_path = argv[++i];
+        } else if (arg == "--pattern" && i + 1 < argc) {
+            if (!parse_test_pattern(argv[++i], pattern)) {
+                std::cerr << "Unknown pattern: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg.size() > 1 && arg[0] == '-' && arg[1] == '-') {
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+    
+    // Without a config file the built-in profile keeps the original settings
+    std::vector<EncoderProfile> profiles;
+    if (config_path.empty()) {
+        if (!profile_name.empty() || list_profiles) {
+            std::cerr << "--profile and --list-profiles need --config" << std::endl;
+            return 1;
+        }
+        profiles.emplace_back();
+    } else if (!load_encoder_profiles(config_path, profiles)) {
+        return 1;
+    }
+    
+    if (list_profiles) {
+        for (const EncoderProfile& profile : profiles) {
+            print_encoder_profile(profile);
+        }
+        return 0;
+    }
+    
+    const EncoderProfile* profile = profile_name.empty() ? &profiles.front() : find_encoder_profile(profiles, profile_name);
+    if (!profile) {
+        std::cerr << "No profile named '" << profile_name << "' in " << config_path << std::endl;
+        return 1;
+    }
+    
+    if (input_path.empty()) {
+        if (!input_format_name.empty() || raw_width > 0 || max_frames > 0) {
+            std::cerr << "--input-format, --size and --frames need --input" << std::endl;
+            return 1;
+        }
+        if (positional.size() != 4) {
+            print_usage(argv[0]);
+            return 1;
         }
-        avformat_free_context(format_ctx);
+    } else if (positional.size() != 1) {
+        print_usage(argv[0]);
+        return 1;
     }
     
+    // Input frames replace the pattern; the reader is sequential, so one encoder
+    FrameReader reader;
+    int width = 0;
+    int height = 0;
+    int frame_count = max_frames;
+    const char* output_filename = positional.back();
+    if (!input_path.empty()) {
+        if (chunks > 1) {
+            std::cerr << "--chunks cannot be combined with --input" << std::endl;
+            return 1;
+        }
+        bool raw = input_format_name == "yuv" ||
+                   (input_format_name.empty() && input_path.size() > 4 &&
+                    input_path.compare(input_path.size() - 4, 4, ".yuv") == 0);
+        if (!input_format_name.empty() && input_format_name != "yuv" && input_format_name != "y4m") {
+            std::cerr << "Unknown input format: " << input_format_name << std::endl;
+            return 1;
+        }
+        if (raw && raw_width == 0) {
+            std::cerr << "Raw input needs --size" << std::endl;
+            return 1;
+        }
+        if (!reader.open(input_path, raw ? InputFormat::Raw : InputFormat::Y4m, raw_width, raw_height, raw_rate)) {
+            return 1;
+        }
+        width = reader.get_width();
+        height = reader.get_height();
+    } else {
+        width = std::atoi(positional[0]);
+        height = std::atoi(positional[1]);
+        frame_count = std::atoi(positional[2]);
+        
+        if (width <= 0 || height <= 0 || frame_count <= 0) {
+            std::cerr << "Width, height, and frame count must be positive" << std::endl;
+            return 1;
+        }
+    }
+    
+    SimpleEncoder encoder(*profile, pattern, input_path.empty() ? nullptr : &reader);
+    if (quality) {
+        encoder.enable_quality_meter(quality_log_path);
+    }
+    if (!encoder.open(width, height, frame_count, chunks, output_filename) || !encoder.encode()) {
+        return 1;
+    }
+    
+    std::cout << "Video created successfully: " << output_filename << std::endl;
     return 0;
 }
@@ -1,24 +1,540 @@
 #include <iostream>
 #include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <cstdio>
+#include <array>
+#include <memory>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
 
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/avutil.h>
+#include <libavutil/pixdesc.h>
 }
 
+#include "decoder_threading.h"
+
+// Keyframe position in decode order, collected from packet flags
+struct KeyframeEntry {
+    int64_t frame_index;    // Packet number within the video stream
+    int64_t pts;
+    int64_t dts;
+};
+
+// Statistics derived from demuxed packets alone (no decoding)
+struct PacketStats {
+    int64_t frame_count = 0;
+    int64_t total_size = 0;
+    int64_t reordered_frames = 0;    // pts below an earlier packet's pts: B-frames
+    int64_t first_pts = AV_NOPTS_VALUE;
+    int64_t end_pts = AV_NOPTS_VALUE;  // Largest pts + duration seen
+    std::vector<KeyframeEntry> keyframes;
+};
+
+// Columnar per-frame trace, one row per decoded frame in output order.
+// Columns are reserved up front so recording in the decode loop is a few stores.
+struct FrameTrace {
+    AVRational time_base{0, 1};
+    std::vector<int64_t> pts;
+    std::vector<int64_t> dts;           // dts of the packet that produced the frame
+    std::vector<char> type;             // I, P, B, ... (av_get_picture_type_char)
+    std::vector<int> packet_size;       // -1 when the packet could not be matched
+    std::vector<double> decode_ms;      // avcodec_send_packet to frame availability
+    std::vector<uint8_t> keyframe;
+    
+    size_t size() const {
+        return pts.size();
+    }
+    
+    void reserve(size_t rows) {
+        pts.reserve(rows);
+        dts.reserve(rows);
+        type.reserve(rows);
+        packet_size.reserve(rows);
+        decode_ms.reserve(rows);
+        keyframe.reserve(rows);
+    }
+    
+    void add(int64_t frame_pts, int64_t packet_dts, char picture_type, int size, double latency_ms, bool key) {
+        pts.push_back(frame_pts);
+        dts.push_back(packet_dts);
+        type.push_back(picture_type);
+        packet_size.push_back(size);
+        decode_ms.push_back(latency_ms);
+        keyframe.push_back(key);
+    }
+    
+    void append(const FrameTrace& other) {
+        if (time_base.num == 0) {
+            time_base = other.time_base;
+        }
+        pts.insert(pts.end(), other.pts.begin(), other.pts.end());
+        dts.insert(dts.end(), other.dts.begin(), other.dts.end());
+        type.insert(type.end(), other.type.begin(), other.type.end());
+        packet_size.insert(packet_size.end(), other.packet_size.begin(), other.packet_size.end());
+        decode_ms.insert(decode_ms.end(), other.decode_ms.begin(), other.decode_ms.end());
+        keyframe.insert(keyframe.end(), other.keyframe.begin(), other.keyframe.end());
+    }
+    
+    bool write_csv(const char* path) const {
+        FILE* file = fopen(path, "w");
+        if (!file) {
+            std::cerr << "Could not open " << path << " for writing" << std::endl;
+            return false;
+        }
+        
+        fprintf(file, "frame,pts,dts,time,type,packet_size,decode_ms,keyframe\n");
+        for (size_t i = 0; i < size(); i++) {
+            double time = pts[i] != AV_NOPTS_VALUE ? pts[i] * av_q2d(time_base) : 0.0;
+            fprintf(file, "%zu,%lld,%lld,%.6f,%c,%d,%.3f,%d\n", i,
+                    static_cast<long long>(pts[i]), static_cast<long long>(dts[i]),
+                    time, type[i], packet_size[i], decode_ms[i], keyframe[i]);
+        }
+        
+        bool ok = fclose(file) == 0;
+        if (!ok) {
+            std::cerr << "Error writing " << path << std::endl;
+        }
+        return ok;
+    }
+};
+
+// HDR-style log-linear histogram of latencies in microseconds: exact below
+// 32us, then 32 sub-buckets per power of two (about 3% resolution) up to
+// 2^35us (~9.5 hours); longer values share the last bucket. Fixed storage,
+// so recording never allocates.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr int64_t SUB_BUCKETS = int64_t(1) << SUB_BUCKET_BITS;
+    static constexpr int MAX_MAGNITUDE = 29;    // Largest shift before clamping: 64 << 29 = 2^35us
+    static constexpr size_t BUCKET_COUNT = (MAX_MAGNITUDE + 2) * SUB_BUCKETS;
+    
+    void record(int64_t microseconds) {
+        int64_t value = std::max<int64_t>(microseconds, 0);
+        counts[bucket_index(value)]++;
+        total++;
+        max_value = std::max(max_value, value);
+    }
+    
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < BUCKET_COUNT; i++) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        max_value = std::max(max_value, other.max_value);
+    }
+    
+    int64_t count() const {
+        return total;
+    }
+    
+    int64_t max() const {
+        return max_value;
+    }
+    
+    // Upper bound of the bucket holding the given quantile (0..1)
+    int64_t percentile(double quantile) const {
+        if (total == 0) {
+            return 0;
+        }
+        int64_t rank = std::max<int64_t>(1, static_cast<int64_t>(quantile * total + 0.5));
+        int64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; i++) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return std::min(bucket_upper_bound(i), max_value);
+            }
+        }
+        return max_value;
+    }
+    
+private:
+    std::array<int64_t, BUCKET_COUNT> counts{};
+    int64_t total = 0;
+    int64_t max_value = 0;
+    
+    static size_t bucket_index(int64_t value) {
+        if (value < SUB_BUCKETS) {
+            return value;
+        }
+        int magnitude = 0;
+        while ((value >> magnitude) >= 2 * SUB_BUCKETS) {
+            magnitude++;
+        }
+        if (magnitude > MAX_MAGNITUDE) {
+            return BUCKET_COUNT - 1;
+        }
+        return (magnitude + 1) * SUB_BUCKETS + ((value >> magnitude) - SUB_BUCKETS);
+    }
+    
+    static int64_t bucket_upper_bound(size_t index) {
+        if (index < static_cast<size_t>(SUB_BUCKETS)) {
+            return index;
+        }
+        int magnitude = index / SUB_BUCKETS - 1;
+        int64_t lower = (static_cast<int64_t>(index % SUB_BUCKETS) + SUB_BUCKETS) << magnitude;
+        return lower + (int64_t(1) << magnitude) - 1;
+    }
+};
+
+// Decode latency (avcodec_send_packet to frame availability) per picture type
+struct DecodeLatency {
+    static constexpr int TYPE_COUNT = 4;
+    static constexpr const char* TYPE_NAMES[TYPE_COUNT] = {"I", "P", "B", "Other"};
+    std::array<LatencyHistogram, TYPE_COUNT> by_type;
+    
+    void record(AVPictureType picture_type, int64_t microseconds) {
+        int type = picture_type == AV_PICTURE_TYPE_I ? 0 :
+                   picture_type == AV_PICTURE_TYPE_P ? 1 :
+                   picture_type == AV_PICTURE_TYPE_B ? 2 : 3;
+        by_type[type].record(microseconds);
+    }
+    
+    void merge(const DecodeLatency& other) {
+        for (int i = 0; i < TYPE_COUNT; i++) {
+            by_type[i].merge(other.by_type[i]);
+        }
+    }
+    
+    void print() const {
+        LatencyHistogram all;
+        for (const LatencyHistogram& histogram : by_type) {
+            all.merge(histogram);
+        }
+        if (all.count() == 0) {
+            return;
+        }
+        
+        std::cout << "\n=== Decode Latency (ms) ===" << std::endl;
+        std::cout << "Type   " << std::setw(8) << "Frames" << std::setw(10) << "p50" << std::setw(10) << "p90"
+                  << std::setw(10) << "p99" << std::setw(10) << "max" << std::endl;
+        for (int i = 0; i <= TYPE_COUNT; i++) {
+            const LatencyHistogram& histogram = i < TYPE_COUNT ? by_type[i] : all;
+            if (histogram.count() == 0) {
+                continue;
+            }
+            std::cout << std::left << std::setw(7) << (i < TYPE_COUNT ? TYPE_NAMES[i] : "All") << std::right
+                      << std::setw(8) << histogram.count()
+                      << std::setw(10) << histogram.percentile(0.50) / 1000.0
+                      << std::setw(10) << histogram.percentile(0.90) / 1000.0
+                      << std::setw(10) << histogram.percentile(0.99) / 1000.0
+                      << std::setw(10) << histogram.max() / 1000.0 << std::endl;
+        }
+    }
+};
+
+// Running totals of the decode pass
+struct FrameStats {
+    int frame_count = 0;
+    int64_t total_size = 0;             // Bytes of every packet sent to the decoder
+    double total_duration = 0.0;
+    FrameTrace trace;                   // Filled only when tracing is enabled
+    DecodeLatency latency;
+    
+    // Combine the totals of another segment of the same stream
+    void merge(const FrameStats& other) {
+        frame_count += other.frame_count;
+        total_size += other.total_size;
+        total_duration = std::max(total_duration, other.total_duration);
+        trace.append(other.trace);
+        latency.merge(other.latency);
+    }
+};
+
+// Packet attributes kept until the decoder returns the matching frame. The
+// packet's sequence number travels through AVPacket.opaque to AVFrame.opaque
+// (AV_CODEC_FLAG_COPY_OPAQUE), so reordered frames get their own packet's data.
+struct PacketInfo {
+    int64_t sequence = -1;
+    int64_t dts = AV_NOPTS_VALUE;
+    int size = 0;
+    std::chrono::steady_clock::time_point send_time;
+};
+
+// Must exceed the decoder delay (reorder depth + frame threads)
+constexpr size_t PACKET_RING_SIZE = 1024;
+
+// GOP-aligned slice of the video stream for segment-parallel analysis. A
+// segment owns the packets from its keyframe up to the next segment's keyframe.
+struct SegmentRange {
+    int64_t first_frame = 0;              // Packet index of the starting keyframe
+    int64_t start_ts = AV_NOPTS_VALUE;    // Starting keyframe timestamp (NOPTS = file start)
+    int64_t end_ts = AV_NOPTS_VALUE;      // Next segment's keyframe timestamp (NOPTS = file end)
+};
+
+// Segment boundaries are matched on dts, falling back to pts for demuxers
+// that leave dts unset
+int64_t packet_timestamp(int64_t pts, int64_t dts) {
+    return dts != AV_NOPTS_VALUE ? dts : pts;
+}
+
+// Split the stream into at most segment_count ranges of roughly equal packet
+// counts, each starting at a keyframe from the demux-only index.
+std::vector<SegmentRange> plan_segments(const PacketStats& packets, int segment_count) {
+    std::vector<SegmentRange> segments(1);
+    
+    for (const KeyframeEntry& keyframe : packets.keyframes) {
+        int64_t timestamp = packet_timestamp(keyframe.pts, keyframe.dts);
+        if (timestamp == AV_NOPTS_VALUE || keyframe.frame_index == 0) {
+            continue;
+        }
+        if (static_cast<int>(segments.size()) == segment_count) {
+            break;
+        }
+        
+        int64_t target = packets.frame_count * static_cast<int64_t>(segments.size()) / segment_count;
+        if (keyframe.frame_index >= target) {
+            segments.back().end_ts = timestamp;
+            segments.push_back({keyframe.frame_index, timestamp, AV_NOPTS_VALUE});
+        }
+    }
+    return segments;
+}
+
+void print_frame_summary(const FrameStats& stats, double elapsed) {
+    std::cout << "\n=== Analysis Summary ===" << std::endl;
+    std::cout << "Total frames: " << stats.frame_count << std::endl;
+    std::cout << "Total duration: " << stats.total_duration << " seconds" << std::endl;
+    if (stats.total_duration > 0) {
+        std::cout << "Average FPS: " << stats.frame_count / stats.total_duration << std::endl;
+    }
+    std::cout << "Total video data: " << stats.total_size << " bytes" << std::endl;
+    if (stats.frame_count > 0) {
+        std::cout << "Average frame size: " << stats.total_size / stats.frame_count << " bytes" << std::endl;
+    }
+    std::cout << "Decode time: " << elapsed << " seconds" << std::endl;
+    if (elapsed > 0) {
+        std::cout << "Decode speed: " << stats.frame_count / elapsed << " fps" << std::endl;
+    }
+    stats.latency.print();
+}
+
+// Sum of absolute differences between two rows of 8-bit samples
+using SadRowFunction = uint64_t (*)(const uint8_t* a, const uint8_t* b, int width);
+
+static uint64_t sad_row_scalar(const uint8_t* a, const uint8_t* b, int width) {
+    uint64_t sum = 0;
+    for (int i = 0; i < width; i++) {
+        sum += std::abs(a[i] - b[i]);
+    }
+    return sum;
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+// psadbw: 16 absolute differences summed into two 64-bit lanes per instruction
+static uint64_t sad_row_sse2(const uint8_t* a, const uint8_t* b, int width) {
+    __m128i acc = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= width; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+    }
+    uint64_t sum = _mm_cvtsi128_si64(acc) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc));
+    return sum + sad_row_scalar(a + i, b + i, width - i);
+}
+
+#if defined(__GNUC__)
+__attribute__((target("avx2")))
+static uint64_t sad_row_avx2(const uint8_t* a, const uint8_t* b, int width) {
+    __m256i acc = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 32 <= width; i += 32) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(va, vb));
+    }
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    uint64_t sum = _mm_cvtsi128_si64(half) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(half, half));
+    return sum + sad_row_sse2(a + i, b + i, width - i);
+}
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+static uint64_t sad_row_neon(const uint8_t* a, const uint8_t* b, int width) {
+    uint32x4_t acc = vdupq_n_u32(0);
+    int i = 0;
+    for (; i + 16 <= width; i += 16) {
+        uint8x16_t diff = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+        acc = vpadalq_u16(acc, vpaddlq_u8(diff));
+    }
+    return vaddlvq_u32(acc) + sad_row_scalar(a + i, b + i, width - i);
+}
+#endif
+
+// Pick the widest kernel the CPU supports (checked once at startup)
+SadRowFunction select_sad_row(const char*& name) {
+#if defined(__x86_64__) || defined(_M_X64)
+#if defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2")) {
+        name = "avx2";
+        return sad_row_avx2;
+    }
+#endif
+    name = "sse2";
+    return sad_row_sse2;
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    name = "neon";
+    return sad_row_neon;
+#else
+    name = "scalar";
+    return sad_row_scalar;
+#endif
+}
+
+struct SceneCut {
+    int frame_number;
+    double timestamp;
+    double score;
+};
+
+// Shot-boundary detection on decoded luma. The mean absolute frame
+// difference (MAFD, 0-100) is computed directly on frame->data[0] against a
+// reference to the previous frame, so no plane is copied. The scene score is
+// min(MAFD, |MAFD - previous MAFD|), as in FFmpeg's scdet filter, which
+// ignores steady high motion and reacts to sudden jumps.
+class SceneDetector {
+public:
+    SceneDetector(double threshold, int row_step)
+        : threshold(threshold), row_step(row_step) {
+        sad_row = select_sad_row(kernel_name);
+        previous = av_frame_alloc();
+    }
+    
+    ~SceneDetector() {
+        av_frame_free(&previous);
+    }
+    
+    // Returns false on allocation failure
+    bool process(const AVFrame* frame, int frame_number, double timestamp) {
+        if (!previous || !has_8bit_luma(frame)) {
+            return previous != nullptr;
+        }
+        
+        if (previous->data[0] && previous->width == frame->width && previous->height == frame->height) {
+            uint64_t sad = 0;
+            int64_t rows = 0;
+            for (int y = 0; y < frame->height; y += row_step) {
+                sad += sad_row(frame->data[0] + static_cast<ptrdiff_t>(y) * frame->linesize[0],
+                               previous->data[0] + static_cast<ptrdiff_t>(y) * previous->linesize[0],
+                               frame->width);
+                rows++;
+            }
+            
+            double mafd = sad * 100.0 / (static_cast<double>(rows) * frame->width * 256);
+            double score = std::min(mafd, std::abs(mafd - previous_mafd));
+            previous_mafd = mafd;
+            
+            if (score >= threshold) {
+                cuts.push_back({frame_number, timestamp, score});
+            }
+        } else if (previous->data[0]) {
+            // Resolution change mid-stream (adaptive streams, spliced sources):
+            // the frames are not comparable, so count it as a cut at full score
+            // and start the motion history over
+            previous_mafd = 0.0;
+            cuts.push_back({frame_number, timestamp, 100.0});
+        }
+        
+        // Keep a reference, not a copy: the decoder's buffer stays alive one frame longer
+        av_frame_unref(previous);
+        return av_frame_ref(previous, frame) >= 0;
+    }
+    
+    void print() const {
+        std::cout << "\n=== Scene Cuts (" << kernel_name << " SAD, row step " << row_step
+                  << ", threshold " << threshold << ") ===" << std::endl;
+        if (skipped_format != AV_PIX_FMT_NONE) {
+            const char* name = av_get_pix_fmt_name(skipped_format);
+            std::cout << "(frames in " << (name ? name : "unknown") << " skipped: 8-bit planar luma required)" << std::endl;
+        }
+        for (size_t i = 0; i < cuts.size(); i++) {
+            std::cout << "Cut " << std::setw(4) << i + 1
+                      << " | Frame " << std::setw(6) << cuts[i].frame_number
+                      << " | Time: " << std::setw(8) << cuts[i].timestamp << "s"
+                      << " | Score: " << std::setw(6) << cuts[i].score << std::endl;
+        }
+        std::cout << "Scenes: " << cuts.size() + 1 << std::endl;
+    }
+    
+private:
+    double threshold;
+    int row_step;           // Compare every n-th luma row to cut memory traffic
+    SadRowFunction sad_row;
+    const char* kernel_name = "scalar";
+    AVFrame* previous = nullptr;
+    double previous_mafd = 0.0;
+    std::vector<SceneCut> cuts;
+    int checked_format = AV_PIX_FMT_NONE;
+    bool format_usable = false;
+    AVPixelFormat skipped_format = AV_PIX_FMT_NONE;
+    
+    bool has_8bit_luma(const AVFrame* frame) {
+        if (frame->format != checked_format) {
+            const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+            const uint64_t unsupported = AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_RGB |
+                                         AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM;
+            checked_format = frame->format;
+            format_usable = desc && !(desc->flags & unsupported) && desc->comp[0].depth == 8 &&
+                            desc->comp[0].plane == 0 && desc->comp[0].step == 1;
+            if (!format_usable) {
+                skipped_format = static_cast<AVPixelFormat>(frame->format);
+            }
+        }
+        return format_usable;
+    }
+};
+
 class VideoAnalyzer {
 private:
     AVFormatContext* format_ctx = nullptr;
     AVCodecContext* video_codec_ctx = nullptr;
     int video_stream_index = -1;
+    DecoderThreading threading;
+    bool verbose = true;    // Decoder banner and per-frame lines
+    bool record_trace = false;
+    std::vector<PacketInfo> packets_in_flight = std::vector<PacketInfo>(PACKET_RING_SIZE);
+    int64_t next_packet_sequence = 0;
+    std::unique_ptr<SceneDetector> scene_detector;
     
 public:
     ~VideoAnalyzer() {
         cleanup();
     }
     
-    bool open_file(const char* filename) {
+    void set_threading(const DecoderThreading& decoder_threading) {
+        threading = decoder_threading;
+    }
+    
+    // Segment workers run quietly so their output does not interleave
+    void set_verbose(bool enabled) {
+        verbose = enabled;
+    }
+    
+    // Record a per-frame row into FrameStats::trace during decoding
+    void set_frame_trace(bool enabled) {
+        record_trace = enabled;
+    }
+    
+    // Run shot-boundary detection on every decoded frame of analyze_frames
+    void enable_scene_detection(double threshold, int row_step) {
+        scene_detector.reset(new SceneDetector(threshold, row_step));
+    }
+    
+    // open_decoder = false prepares a demux-only pass (see analyze_packets)
+    bool open_file(const char* filename, bool open_decoder = true) {
         // Open input file
         int ret = avformat_open_input(&format_ctx, filename, nullptr, nullptr);
         if (ret < 0) {
@@ -46,6 +562,16 @@ public:
             return false;
         }
         
+        if (!open_decoder) {
+            // Let the demuxer drop everything but video without reading the payloads
+            for (unsigned int i = 0; i < format_ctx->nb_streams; i++) {
+                if (static_cast<int>(i) != video_stream_index) {
+                    format_ctx->streams[i]->discard = AVDISCARD_ALL;
+                }
+            }
+            return true;
+        }
+        
         // Get codec parameters
         AVCodecParameters* codecpar = format_ctx->streams[video_stream_index]->codecpar;
         
@@ -70,6 +596,13 @@ public:
             return false;
         }
         
+        if (!configure_decoder_threads(video_codec_ctx, threading)) {
+            return false;
+        }
+        
+        // Carry AVPacket.opaque over to the frame it produces
+        video_codec_ctx->flags |= AV_CODEC_FLAG_COPY_OPAQUE;
+        
         // Open codec
         ret = avcodec_open2(video_codec_ctx, codec, nullptr);
         if (ret < 0) {
@@ -77,10 +610,15 @@ public:
             return false;
         }
         
+        if (verbose) {
+            std::cout << "Decoder: " << codec->name << " | Threads: " << video_codec_ctx->thread_count
+                      << " (" << thread_type_name(video_codec_ctx->active_thread_type) << ")" << std::endl;
+        }
+        
         return true;
     }
     
-    void analyze_frames() {
+    void analyze_frames(FrameStats& stats) {
         AVPacket* packet = av_packet_alloc();
         AVFrame* frame = av_frame_alloc();
         
@@ -89,70 +627,316 @@ public:
             return;
         }
         
-        int frame_count = 0;
-        int64_t total_size = 0;
-        double total_duration = 0.0;
+        if (record_trace) {
+            start_trace(stats.trace, estimate_frame_count());
+        }
+        int ret = 0;
         
         std::cout << "=== Frame Analysis ===" << std::endl;
         std::cout << std::fixed << std::setprecision(3);
         
+        auto start_time = std::chrono::steady_clock::now();
+        
         while (av_read_frame(format_ctx, packet) >= 0) {
             if (packet->stream_index == video_stream_index) {
-                int ret = avcodec_send_packet(video_codec_ctx, packet);
+                ret = send_packet(packet, stats);
                 if (ret < 0) {
                     print_error("Error sending packet to decoder", ret);
+                    av_packet_unref(packet);
                     break;
                 }
                 
-                while (ret >= 0) {
-                    ret = avcodec_receive_frame(video_codec_ctx, frame);
-                    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-                        break;
-                    } else if (ret < 0) {
-                        print_error("Error during decoding", ret);
-                        goto cleanup;
-                    }
-                    
-                    frame_count++;
-                    total_size += packet->size;
-                    
-                    // Calculate timestamp
-                    double timestamp = frame->pts * av_q2d(format_ctx->streams[video_stream_index]->time_base);
-                    total_duration = timestamp;
-                    
-                    // Print frame info (every 30th frame to avoid spam)
-                    if (frame_count % 30 == 0) {
-                        std::cout << "Frame " << std::setw(6) << frame_count 
-                                 << " | Time: " << std::setw(8) << timestamp << "s"
-                                 << " | Type: " << (frame->pict_type == AV_PICTURE_TYPE_I ? "I" : 
-                                                   frame->pict_type == AV_PICTURE_TYPE_P ? "P" : 
-                                                   frame->pict_type == AV_PICTURE_TYPE_B ? "B" : "?")
-                                 << " | Size: " << std::setw(8) << packet->size << " bytes" << std::endl;
+                ret = receive_frames(frame, stats);
+                if (ret < 0) {
+                    av_packet_unref(packet);
+                    break;
+                }
+            }
+            av_packet_unref(packet);
+        }
+        
+        // Drain the frames still held by the decoder (frame threading keeps one per thread)
+        if (ret >= 0 && avcodec_send_packet(video_codec_ctx, nullptr) >= 0) {
+            receive_frames(frame, stats);
+        }
+        
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        print_frame_summary(stats, elapsed);
+        if (scene_detector) {
+            scene_detector->print();
+        }
+        
+        av_packet_free(&packet);
+        av_frame_free(&frame);
+    }
+    
+    // Decode one segment: seek to (at or before) its starting keyframe, skip
+    // packets up to that keyframe and stop at the next segment's keyframe, so
+    // every packet is decoded by exactly one segment. Leading pictures of an
+    // open GOP reference the previous segment and may be dropped by the decoder.
+    bool analyze_segment(const SegmentRange& range, FrameStats& stats, size_t expected_frames) {
+        if (record_trace) {
+            start_trace(stats.trace, expected_frames);
+        }
+        
+        AVPacket* packet = av_packet_alloc();
+        AVFrame* frame = av_frame_alloc();
+        bool ok = packet && frame;
+        bool started = range.start_ts == AV_NOPTS_VALUE;
+        
+        if (!ok) {
+            std::cerr << "Could not allocate packet or frame" << std::endl;
+        } else if (!started) {
+            // max_ts = start_ts: land on the keyframe or before it, never after
+            int ret = avformat_seek_file(format_ctx, video_stream_index, INT64_MIN,
+                                         range.start_ts, range.start_ts, 0);
+            if (ret < 0) {
+                print_error("Could not seek to segment start", ret);
+                ok = false;
+            }
+        }
+        
+        while (ok && av_read_frame(format_ctx, packet) >= 0) {
+            if (packet->stream_index == video_stream_index) {
+                bool keyframe = packet->flags & AV_PKT_FLAG_KEY;
+                int64_t timestamp = packet_timestamp(packet->pts, packet->dts);
+                
+                if (!started) {
+                    started = keyframe && timestamp == range.start_ts;
+                } else if (keyframe && range.end_ts != AV_NOPTS_VALUE && timestamp == range.end_ts) {
+                    av_packet_unref(packet);
+                    break;
+                }
+                
+                if (started) {
+                    int ret = send_packet(packet, stats);
+                    if (ret < 0) {
+                        print_error("Error sending packet to decoder", ret);
+                        ok = false;
+                    } else {
+                        ok = receive_frames(frame, stats) >= 0;
                     }
-                    
-                    av_frame_unref(frame);
                 }
             }
             av_packet_unref(packet);
         }
         
-    cleanup:
-        std::cout << "\n=== Analysis Summary ===" << std::endl;
-        std::cout << "Total frames: " << frame_count << std::endl;
-        std::cout << "Total duration: " << total_duration << " seconds" << std::endl;
-        if (total_duration > 0) {
-            std::cout << "Average FPS: " << frame_count / total_duration << std::endl;
+        if (ok && !started) {
+            std::cerr << "Segment keyframe at frame " << range.first_frame << " not found after seek" << std::endl;
+            ok = false;
         }
-        std::cout << "Total video data: " << total_size << " bytes" << std::endl;
-        if (frame_count > 0) {
-            std::cout << "Average frame size: " << total_size / frame_count << " bytes" << std::endl;
+        if (ok && avcodec_send_packet(video_codec_ctx, nullptr) >= 0) {
+            ok = receive_frames(frame, stats) >= 0;
         }
         
         av_packet_free(&packet);
         av_frame_free(&frame);
+        return ok;
+    }
+    
+    // Read every video packet without decoding and collect size, keyframe
+    // and reordering statistics from the packet flags and timestamps.
+    bool scan_packets(PacketStats& stats) {
+        AVPacket* packet = av_packet_alloc();
+        if (!packet) {
+            std::cerr << "Could not allocate packet" << std::endl;
+            return false;
+        }
+        
+        int64_t max_pts = AV_NOPTS_VALUE;
+        int ret;
+        
+        while ((ret = av_read_frame(format_ctx, packet)) >= 0) {
+            if (packet->stream_index == video_stream_index) {
+                if (packet->flags & AV_PKT_FLAG_KEY) {
+                    stats.keyframes.push_back({stats.frame_count, packet->pts, packet->dts});
+                }
+                
+                if (packet->pts != AV_NOPTS_VALUE) {
+                    if (max_pts != AV_NOPTS_VALUE && packet->pts < max_pts) {
+                        stats.reordered_frames++;
+                    }
+                    max_pts = std::max(max_pts, packet->pts);
+                    
+                    if (stats.first_pts == AV_NOPTS_VALUE || packet->pts < stats.first_pts) {
+                        stats.first_pts = packet->pts;
+                    }
+                    stats.end_pts = std::max(stats.end_pts, packet->pts + packet->duration);
+                }
+                
+                stats.frame_count++;
+                stats.total_size += packet->size;
+            }
+            av_packet_unref(packet);
+        }
+        
+        av_packet_free(&packet);
+        
+        if (ret != AVERROR_EOF) {
+            print_error("Error reading packet", ret);
+            return false;
+        }
+        return true;
+    }
+    
+    // Demux-only analysis: frame count, keyframe positions, GOP structure and
+    // bitrate from AVPacket flags and sizes, without avcodec_send_packet.
+    void analyze_packets() {
+        auto start_time = std::chrono::steady_clock::now();
+        
+        PacketStats stats;
+        bool complete = scan_packets(stats);
+        
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        AVRational time_base = format_ctx->streams[video_stream_index]->time_base;
+        
+        std::cout << "=== Packet Analysis (demux only) ===" << std::endl;
+        std::cout << std::fixed << std::setprecision(3);
+        
+        // GOP length = packets from one keyframe to the next
+        std::vector<int64_t> gop_lengths;
+        for (size_t i = 0; i < stats.keyframes.size(); i++) {
+            const KeyframeEntry& keyframe = stats.keyframes[i];
+            int64_t next_index = (i + 1 < stats.keyframes.size()) ? stats.keyframes[i + 1].frame_index : stats.frame_count;
+            gop_lengths.push_back(next_index - keyframe.frame_index);
+            
+            double timestamp = keyframe.pts != AV_NOPTS_VALUE ? keyframe.pts * av_q2d(time_base) : 0.0;
+            std::cout << "Keyframe at frame " << std::setw(6) << keyframe.frame_index
+                      << " | Time: " << std::setw(8) << timestamp << "s"
+                      << " | GOP: " << std::setw(4) << gop_lengths.back() << " frames" << std::endl;
+        }
+        
+        double duration = 0.0;
+        if (stats.first_pts != AV_NOPTS_VALUE && stats.end_pts != AV_NOPTS_VALUE) {
+            duration = (stats.end_pts - stats.first_pts) * av_q2d(time_base);
+        }
+        
+        std::cout << "\n=== Analysis Summary ===" << std::endl;
+        if (!complete) {
+            std::cout << "(stopped early because of a read error)" << std::endl;
+        }
+        std::cout << "Total frames: " << stats.frame_count << std::endl;
+        std::cout << "Keyframes: " << stats.keyframes.size() << std::endl;
+        if (!gop_lengths.empty()) {
+            int64_t gop_sum = 0;
+            for (int64_t length : gop_lengths) {
+                gop_sum += length;
+            }
+            std::cout << "GOP length: min " << *std::min_element(gop_lengths.begin(), gop_lengths.end())
+                      << " / avg " << (double)gop_sum / gop_lengths.size()
+                      << " / max " << *std::max_element(gop_lengths.begin(), gop_lengths.end()) << " frames" << std::endl;
+        }
+        std::cout << "B-frames (from pts reordering): " << stats.reordered_frames << std::endl;
+        std::cout << "Total duration: " << duration << " seconds" << std::endl;
+        if (duration > 0) {
+            std::cout << "Average FPS: " << stats.frame_count / duration << std::endl;
+            std::cout << "Average bitrate: " << stats.total_size * 8 / duration / 1000.0 << " kbps" << std::endl;
+        }
+        std::cout << "Total video data: " << stats.total_size << " bytes" << std::endl;
+        if (stats.frame_count > 0) {
+            std::cout << "Average frame size: " << stats.total_size / stats.frame_count << " bytes" << std::endl;
+        }
+        std::cout << "Analysis time: " << elapsed << " seconds" << std::endl;
     }
     
 private:
+    // Container frame count, or duration x frame rate, for sizing the trace
+    size_t estimate_frame_count() const {
+        const AVStream* stream = format_ctx->streams[video_stream_index];
+        if (stream->nb_frames > 0) {
+            return stream->nb_frames;
+        }
+        if (format_ctx->duration > 0 && stream->avg_frame_rate.num > 0) {
+            return format_ctx->duration * av_q2d(stream->avg_frame_rate) / AV_TIME_BASE + 1;
+        }
+        return 4096;
+    }
+    
+    void start_trace(FrameTrace& trace, size_t expected_frames) {
+        trace.time_base = format_ctx->streams[video_stream_index]->time_base;
+        trace.reserve(expected_frames);
+    }
+    
+    // Tag the packet with a sequence number the decoder copies to its frame,
+    // remember the packet's attributes, then submit it
+    int send_packet(AVPacket* packet, FrameStats& stats) {
+        int64_t sequence = next_packet_sequence++;
+        PacketInfo& info = packets_in_flight[sequence % PACKET_RING_SIZE];
+        info.sequence = sequence;
+        info.dts = packet->dts;
+        info.size = packet->size;
+        info.send_time = std::chrono::steady_clock::now();
+        
+        packet->opaque = reinterpret_cast<void*>(static_cast<intptr_t>(sequence + 1));
+        stats.total_size += packet->size;
+        return avcodec_send_packet(video_codec_ctx, packet);
+    }
+    
+    // The packet that produced this frame, or nullptr if the decoder dropped
+    // the tag or the ring slot has since been reused
+    const PacketInfo* find_source_packet(const AVFrame* frame) const {
+        intptr_t tag = reinterpret_cast<intptr_t>(frame->opaque);
+        if (tag <= 0) {
+            return nullptr;
+        }
+        const PacketInfo& info = packets_in_flight[(tag - 1) % PACKET_RING_SIZE];
+        return info.sequence == tag - 1 ? &info : nullptr;
+    }
+    
+    // Pull every frame the decoder has ready. Returns 0 once it needs more
+    // input (or is fully drained), or a negative error code.
+    int receive_frames(AVFrame* frame, FrameStats& stats) {
+        AVRational time_base = format_ctx->streams[video_stream_index]->time_base;
+        
+        while (true) {
+            int ret = avcodec_receive_frame(video_codec_ctx, frame);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+                return 0;
+            } else if (ret < 0) {
+                print_error("Error during decoding", ret);
+                return ret;
+            }
+            
+            auto available_time = std::chrono::steady_clock::now();
+            const PacketInfo* source = find_source_packet(frame);
+            int packet_size = source ? source->size : -1;
+            
+            stats.frame_count++;
+            
+            // Calculate timestamp
+            double timestamp = frame->pts * av_q2d(time_base);
+            stats.total_duration = timestamp;
+            
+            if (source) {
+                auto latency = std::chrono::duration_cast<std::chrono::microseconds>(available_time - source->send_time);
+                stats.latency.record(frame->pict_type, latency.count());
+            }
+            
+            if (record_trace) {
+                double decode_ms = source ? std::chrono::duration<double, std::milli>(available_time - source->send_time).count() : -1.0;
+                stats.trace.add(frame->pts, source ? source->dts : frame->pkt_dts,
+                                av_get_picture_type_char(frame->pict_type), packet_size, decode_ms,
+                                frame->flags & AV_FRAME_FLAG_KEY);
+            }
+            
+            if (scene_detector && !scene_detector->process(frame, stats.frame_count - 1, timestamp)) {
+                std::cerr << "Could not reference frame for scene detection" << std::endl;
+                av_frame_unref(frame);
+                return AVERROR(ENOMEM);
+            }
+            
+            // Print frame info (every 30th frame to avoid spam)
+            if (verbose && stats.frame_count % 30 == 0) {
+                std::cout << "Frame " << std::setw(6) << stats.frame_count 
+                         << " | Time: " << std::setw(8) << timestamp << "s"
+                         << " | Type: " << av_get_picture_type_char(frame->pict_type)
+                         << " | Size: " << std::setw(8) << packet_size << " bytes" << std::endl;
+            }
+            
+            av_frame_unref(frame);
+        }
+    }
+    
     void cleanup() {
         if (video_codec_ctx) {
             avcodec_free_context(&video_codec_ctx);
@@ -169,19 +953,180 @@ private:
     }
 };
 
+// Per-segment outcome, filled in by the worker that decoded it
+struct SegmentResult {
+    FrameStats stats;
+    double elapsed = 0.0;
+    bool ok = false;
+};
+
+// Segment-parallel analysis: one demux-only pass builds the keyframe index,
+// then GOP-aligned segments are decoded concurrently, each by a VideoAnalyzer
+// with its own AVFormatContext and decoder, and the statistics are merged.
+bool analyze_segments(const char* filename, int segment_count, const DecoderThreading& threading, const char* trace_path) {
+    auto start_time = std::chrono::steady_clock::now();
+    
+    PacketStats packets;
+    {
+        VideoAnalyzer indexer;
+        if (!indexer.open_file(filename, false) || !indexer.scan_packets(packets)) {
+            return false;
+        }
+    }
+    double index_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    
+    std::vector<SegmentRange> segments = plan_segments(packets, segment_count);
+    std::vector<SegmentResult> results(segments.size());
+    
+    unsigned int hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t worker_count = std::min<size_t>(segments.size(), hardware_threads);
+    
+    std::cout << "=== Segment-Parallel Frame Analysis ===" << std::endl;
+    std::cout << "Keyframes: " << packets.keyframes.size() << " | Segments: " << segments.size()
+              << " | Workers: " << worker_count << " | Decoder threads per segment: " << threading.thread_count << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    
+    // Workers claim segments in order; more segments than cores balances uneven GOPs
+    std::atomic<size_t> next_segment{0};
+    auto worker = [&]() {
+        for (size_t i = next_segment++; i < segments.size(); i = next_segment++) {
+            auto segment_start = std::chrono::steady_clock::now();
+            int64_t end_frame = (i + 1 < segments.size()) ? segments[i + 1].first_frame : packets.frame_count;
+            VideoAnalyzer analyzer;
+            analyzer.set_threading(threading);
+            analyzer.set_verbose(false);
+            analyzer.set_frame_trace(trace_path != nullptr);
+            results[i].ok = analyzer.open_file(filename) &&
+                            analyzer.analyze_segment(segments[i], results[i].stats, end_frame - segments[i].first_frame);
+            results[i].elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - segment_start).count();
+        }
+    };
+    
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < worker_count; i++) {
+        workers.emplace_back(worker);
+    }
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+    
+    FrameStats stats;
+    if (trace_path) {
+        stats.trace.reserve(packets.frame_count);
+    }
+    bool complete = true;
+    for (size_t i = 0; i < segments.size(); i++) {
+        int64_t end_frame = (i + 1 < segments.size()) ? segments[i + 1].first_frame : packets.frame_count;
+        std::cout << "Segment " << std::setw(3) << i
+                  << " | Packets: " << std::setw(6) << segments[i].first_frame << "-" << std::setw(6) << end_frame - 1
+                  << " | Frames: " << std::setw(6) << results[i].stats.frame_count
+                  << " | Time: " << std::setw(8) << results[i].elapsed << "s"
+                  << (results[i].ok ? "" : " | FAILED") << std::endl;
+        stats.merge(results[i].stats);
+        complete = complete && results[i].ok;
+    }
+    
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    print_frame_summary(stats, elapsed);
+    std::cout << "Index time: " << index_time << " seconds" << std::endl;
+    if (!complete) {
+        std::cout << "(some segments failed; totals are partial)" << std::endl;
+    }
+    if (trace_path && !stats.trace.write_csv(trace_path)) {
+        return false;
+    }
+    return complete;
+}
+
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_file>" << std::endl;
+    const char* input_filename = nullptr;
+    bool demux_only = false;
+    bool valid_args = true;
+    bool threads_given = false;
+    int segment_count = 0;
+    const char* trace_path = nullptr;
+    bool detect_scenes = false;
+    double scene_threshold = 10.0;
+    int scene_row_step = 1;
+    DecoderThreading threading;
+    
+    for (int i = 1; i < argc && valid_args; i++) {
+        std::string arg = argv[i];
+        if (arg == "--demux-only") {
+            demux_only = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threading.thread_count = std::atoi(argv[++i]);
+            threads_given = true;
+            valid_args = threading.thread_count >= 0;
+        } else if (arg == "--segments" && i + 1 < argc) {
+            segment_count = std::atoi(argv[++i]);
+            valid_args = segment_count > 0;
+        } else if (arg == "--frame-trace" && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (arg == "--scenes") {
+            detect_scenes = true;
+        } else if (arg == "--scene-threshold" && i + 1 < argc) {
+            scene_threshold = std::atof(argv[++i]);
+            detect_scenes = true;
+            valid_args = scene_threshold > 0 && scene_threshold <= 100;
+        } else if (arg == "--scene-row-step" && i + 1 < argc) {
+            scene_row_step = std::atoi(argv[++i]);
+            detect_scenes = true;
+            valid_args = scene_row_step > 0;
+        } else if (arg == "--thread-type" && i + 1 < argc) {
+            threading.thread_type = argv[++i];
+        } else if (!input_filename && arg[0] != '-') {
+            input_filename = argv[i];
+        } else {
+            valid_args = false;
+        }
+    }
+    
+    // Scene detection compares consecutive frames, so it needs the sequential decode pass
+    bool sequential_only = detect_scenes && (demux_only || segment_count > 0);
+    // Segments are decode jobs; a demux-only pass has nothing to split
+    bool demux_conflict = demux_only && (trace_path || segment_count > 0);
+    if (!input_filename || !valid_args || demux_conflict || sequential_only) {
+        std::cerr << "Usage: " << argv[0] << " [options] <input_file>" << std::endl;
+        std::cerr << "  --demux-only           Analyze packets only (frame count, keyframes, GOPs, bitrate) without decoding" << std::endl;
+        std::cerr << "  --threads <n>          Decoder threads (default: 0 = one per CPU core)" << std::endl;
+        std::cerr << "  --thread-type <mode>   frame, slice or auto (default: auto)" << std::endl;
+        std::cerr << "  --segments <n>         Decode n GOP-aligned segments in parallel (--threads then applies per segment, default 1; not with --demux-only)" << std::endl;
+        std::cerr << "  --frame-trace <csv>    Write pts, dts, type, packet size, decode time and keyframe flag of every frame" << std::endl;
+        std::cerr << "  --scenes               Detect shot boundaries and print cut timestamps (sequential decode only)" << std::endl;
+        std::cerr << "  --scene-threshold <s>  Scene score (0-100) that counts as a cut (default: 10)" << std::endl;
+        std::cerr << "  --scene-row-step <n>   Compare every n-th luma row (default: 1)" << std::endl;
         return 1;
     }
     
+    if (segment_count > 0) {
+        // Segments already use every core; codec threads on top would oversubscribe
+        if (!threads_given) {
+            threading.thread_count = 1;
+        }
+        return analyze_segments(input_filename, segment_count, threading, trace_path) ? 0 : 1;
+    }
+    
     VideoAnalyzer analyzer;
+    analyzer.set_threading(threading);
+    analyzer.set_frame_trace(trace_path != nullptr);
+    if (detect_scenes) {
+        analyzer.enable_scene_detection(scene_threshold, scene_row_step);
+    }
     
-    if (!analyzer.open_file(argv[1])) {
+    if (!analyzer.open_file(input_filename, !demux_only)) {
         return 1;
     }
     
-    analyzer.analyze_frames();
+    if (demux_only) {
+        analyzer.analyze_packets();
+    } else {
+        FrameStats stats;
+        analyzer.analyze_frames(stats);
+        if (trace_path && !stats.trace.write_csv(trace_path)) {
+            return 1;
+        }
+    }
     
     return 0;
 }
@@ -1,5 +1,28 @@
 #include <iostream>
+#include <fstream>
 #include <string>
+#include <string_view>
+#include <charconv>
+#include <cstdio>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
+#include <iterator>
+#include <memory>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -8,94 +31,1153 @@ extern "C" {
 #include <libavutil/pixdesc.h>
 }
 
-void print_stream_info(AVFormatContext* format_ctx) {
-    std::cout << "=== Media File Information ===" << std::endl;
-    std::cout << "Duration: " << format_ctx->duration / AV_TIME_BASE << " seconds" << std::endl;
-    std::cout << "Bitrate: " << format_ctx->bit_rate << " bps" << std::endl;
-    std::cout << "Number of streams: " << format_ctx->nb_streams << std::endl;
-    
+// Floating-point std::to_chars needs libstdc++ 11+, MSVC, or Apple libc++ with
+// a macOS 13.3+ deployment target; older toolchains fall back to snprintf
+#if defined(__cpp_lib_to_chars) && !(defined(__ENVIRONMENT_MAC_OS_X_VERSION_MIN_REQUIRED__) && \
+                                     __ENVIRONMENT_MAC_OS_X_VERSION_MIN_REQUIRED__ < 130300)
+#define HAVE_FLOAT_TO_CHARS 1
+#else
+#define HAVE_FLOAT_TO_CHARS 0
+#endif
+
+// Probe budget and mode selected on the command line
+struct ProbeOptions {
+    bool fast = false;              // Header-only probe, stream analysis only when needed
+    bool report_cost = false;       // Print bytes read and time spent per phase
+    int64_t probesize = -1;         // Max bytes read while probing (-1 = FFmpeg default)
+    int64_t analyzeduration = -1;   // Max stream time analyzed in microseconds (-1 = default)
+    bool ndjson = false;            // One JSON record per line instead of the text report
+    std::string cache_path;         // Probe result cache file (empty = no cache)
+    bool cache_verify = false;      // Also key cache entries on a hash of the file head/tail
+};
+
+// Cost of one probe, split into the container header and stream analysis phases
+struct ProbeStats {
+    int64_t header_bytes = 0;
+    int64_t stream_info_bytes = 0;
+    double header_ms = 0.0;
+    double stream_info_ms = 0.0;
+    bool stream_info_skipped = false;
+    bool from_cache = false;        // Answered from the probe cache, the file was not opened
+    double cache_lookup_ms = 0.0;
+};
+
+// Defaults used by --fast when no explicit budget is given
+const int64_t FAST_PROBESIZE = 256 * 1024;
+const int64_t FAST_ANALYZEDURATION = 500000;
+
+// Duration from the container, or the longest stream when only the header was read
+int64_t get_duration(AVFormatContext* format_ctx) {
+    if (format_ctx->duration != AV_NOPTS_VALUE) {
+        return format_ctx->duration;
+    }
+
+    int64_t duration = AV_NOPTS_VALUE;
+    for (unsigned int i = 0; i < format_ctx->nb_streams; i++) {
+        AVStream* stream = format_ctx->streams[i];
+        if (stream->duration != AV_NOPTS_VALUE) {
+            duration = std::max(duration, av_rescale_q(stream->duration, stream->time_base, AV_TIME_BASE_Q));
+        }
+    }
+    return duration;
+}
+
+// Container bitrate, estimated from the file size when stream analysis was skipped
+int64_t get_bit_rate(AVFormatContext* format_ctx) {
+    if (format_ctx->bit_rate > 0) {
+        return format_ctx->bit_rate;
+    }
+
+    int64_t duration = get_duration(format_ctx);
+    int64_t file_size = format_ctx->pb ? avio_size(format_ctx->pb) : -1;
+    if (duration > 0 && file_size > 0) {
+        return av_rescale(file_size * 8, AV_TIME_BASE, duration);
+    }
+    return 0;
+}
+
+// True when the header alone described every stream well enough to report it.
+// Pixel/sample formats are optional: most demuxers only learn them by decoding.
+bool header_is_complete(AVFormatContext* format_ctx) {
+    for (unsigned int i = 0; i < format_ctx->nb_streams; i++) {
+        AVCodecParameters* codecpar = format_ctx->streams[i]->codecpar;
+        if (codecpar->codec_id == AV_CODEC_ID_NONE) {
+            return false;
+        }
+        if (codecpar->codec_type == AVMEDIA_TYPE_VIDEO && (codecpar->width <= 0 || codecpar->height <= 0)) {
+            return false;
+        }
+        if (codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
+            (codecpar->sample_rate <= 0 || codecpar->ch_layout.nb_channels <= 0)) {
+            return false;
+        }
+    }
+    return format_ctx->nb_streams > 0;
+}
+
+// Everything the report needs from one probed file. Collecting it first lets
+// the text and NDJSON writers share the same data without touching libavformat.
+struct StreamResult {
+    int index = 0;
+    AVMediaType type = AVMEDIA_TYPE_UNKNOWN;
+    std::string codec_name;         // Codec id name, e.g. "h264"
+    std::string decoder_name;       // Empty when no decoder is available
+    std::string decoder_long_name;
+    int64_t bit_rate = 0;
+    int width = 0;
+    int height = 0;
+    std::string pix_fmt;            // Empty when unknown (e.g. header-only probe)
+    double frame_rate = 0.0;
+    int sample_rate = 0;
+    int channels = 0;
+    std::string sample_fmt;
+};
+
+struct ProbeResult {
+    std::string format;
+    int64_t duration = AV_NOPTS_VALUE;   // AV_TIME_BASE units
+    int64_t bit_rate = 0;
+    std::vector<StreamResult> streams;
+};
+
+void collect_probe_result(AVFormatContext* format_ctx, ProbeResult& result) {
+    result.format = format_ctx->iformat ? format_ctx->iformat->name : "";
+    result.duration = get_duration(format_ctx);
+    result.bit_rate = get_bit_rate(format_ctx);
+    result.streams.clear();
+
     for (unsigned int i = 0; i < format_ctx->nb_streams; i++) {
         AVStream* stream = format_ctx->streams[i];
         AVCodecParameters* codecpar = stream->codecpar;
-        
-        std::cout << "\n--- Stream " << i << " ---" << std::endl;
-        std::cout << "Type: ";
-        
-        switch (codecpar->codec_type) {
+        StreamResult info;
+
+        info.index = i;
+        info.type = codecpar->codec_type;
+        info.codec_name = avcodec_get_name(codecpar->codec_id);
+        info.bit_rate = codecpar->bit_rate;
+
+        if (codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+            info.width = codecpar->width;
+            info.height = codecpar->height;
+            const char* pix_fmt_name = av_get_pix_fmt_name(static_cast<AVPixelFormat>(codecpar->format));
+            info.pix_fmt = pix_fmt_name ? pix_fmt_name : "";
+            // The header often carries only the nominal rate
+            AVRational frame_rate = stream->avg_frame_rate.den != 0 && stream->avg_frame_rate.num != 0
+                                        ? stream->avg_frame_rate : stream->r_frame_rate;
+            if (frame_rate.den != 0 && frame_rate.num != 0) {
+                info.frame_rate = av_q2d(frame_rate);
+            }
+        } else if (codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+            info.sample_rate = codecpar->sample_rate;
+            info.channels = codecpar->ch_layout.nb_channels;
+            const char* sample_fmt_name = av_get_sample_fmt_name(static_cast<AVSampleFormat>(codecpar->format));
+            info.sample_fmt = sample_fmt_name ? sample_fmt_name : "";
+        }
+
+        const AVCodec* codec = avcodec_find_decoder(codecpar->codec_id);
+        if (codec) {
+            info.decoder_name = codec->name;
+            info.decoder_long_name = codec->long_name ? codec->long_name : "";
+        }
+
+        result.streams.push_back(std::move(info));
+    }
+}
+
+// Append-only output buffer. Reports are formatted into preallocated memory
+// and handed to stdio in one write per file, instead of going through
+// iostream formatting and a flush on every line.
+class OutputBuffer {
+private:
+    std::string buffer;
+
+public:
+    explicit OutputBuffer(size_t capacity = 64 * 1024) {
+        buffer.reserve(capacity);
+    }
+
+    void clear() { buffer.clear(); }
+    bool empty() const { return buffer.empty(); }
+    const std::string& str() const { return buffer; }
+
+    OutputBuffer& put(char c) {
+        buffer.push_back(c);
+        return *this;
+    }
+
+    OutputBuffer& put(std::string_view text) {
+        buffer.append(text.data(), text.size());
+        return *this;
+    }
+
+    OutputBuffer& put_int(int64_t value) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer.append(digits, result.ptr - digits);
+        return *this;
+    }
+
+    // Same formatting as an ostream with default settings (6 significant digits)
+    OutputBuffer& put_double(double value) {
+        char digits[32];
+#if HAVE_FLOAT_TO_CHARS
+        auto result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::general, 6);
+        buffer.append(digits, result.ptr - digits);
+#else
+        buffer.append(digits, std::snprintf(digits, sizeof(digits), "%g", value));
+#endif
+        return *this;
+    }
+
+    // NDJSON numbers: shortest representation that round-trips ("%.17g" also
+    // round-trips, just with more digits)
+    OutputBuffer& put_json_double(double value) {
+        char digits[32];
+#if HAVE_FLOAT_TO_CHARS
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer.append(digits, result.ptr - digits);
+#else
+        buffer.append(digits, std::snprintf(digits, sizeof(digits), "%.17g", value));
+#endif
+        return *this;
+    }
+
+    // JSON string literal including the quotes
+    OutputBuffer& put_json_string(std::string_view text) {
+        static const char hex[] = "0123456789abcdef";
+        buffer.push_back('"');
+        for (char c : text) {
+            switch (c) {
+                case '"':  buffer.append("\\\""); break;
+                case '\\': buffer.append("\\\\"); break;
+                case '\n': buffer.append("\\n"); break;
+                case '\r': buffer.append("\\r"); break;
+                case '\t': buffer.append("\\t"); break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        buffer.append("\\u00");
+                        buffer.push_back(hex[(c >> 4) & 0xf]);
+                        buffer.push_back(hex[c & 0xf]);
+                    } else {
+                        buffer.push_back(c);
+                    }
+                    break;
+            }
+        }
+        buffer.push_back('"');
+        return *this;
+    }
+
+    // JSON string, or null for an empty value
+    OutputBuffer& put_json_optional(std::string_view text) {
+        return text.empty() ? put("null") : put_json_string(text);
+    }
+
+    // Single write of the whole buffer
+    void write_to(FILE* file) const {
+        std::fwrite(buffer.data(), 1, buffer.size(), file);
+    }
+};
+
+void write_stream_info(const ProbeResult& result, OutputBuffer& out) {
+    out.put("=== Media File Information ===\n");
+    out.put("Format: ").put(result.format.empty() ? "unknown" : result.format).put('\n');
+    if (result.duration != AV_NOPTS_VALUE) {
+        out.put("Duration: ").put_int(result.duration / AV_TIME_BASE).put(" seconds\n");
+    } else {
+        out.put("Duration: unknown\n");
+    }
+    out.put("Bitrate: ").put_int(result.bit_rate).put(" bps\n");
+    out.put("Number of streams: ").put_int(result.streams.size()).put('\n');
+
+    for (const StreamResult& stream : result.streams) {
+        out.put("\n--- Stream ").put_int(stream.index).put(" ---\n");
+        out.put("Type: ");
+
+        switch (stream.type) {
             case AVMEDIA_TYPE_VIDEO:
-                std::cout << "Video" << std::endl;
-                std::cout << "Resolution: " << codecpar->width << "x" << codecpar->height << std::endl;
-                {
-                    const char* pix_fmt_name = av_get_pix_fmt_name(static_cast<AVPixelFormat>(codecpar->format));
-                    std::cout << "Pixel format: " << (pix_fmt_name ? pix_fmt_name : "unknown") << std::endl;
-                }
-                if (stream->avg_frame_rate.den != 0) {
-                    std::cout << "Frame rate: " << (double)stream->avg_frame_rate.num / stream->avg_frame_rate.den << " fps" << std::endl;
+                out.put("Video\n");
+                out.put("Resolution: ").put_int(stream.width).put('x').put_int(stream.height).put('\n');
+                out.put("Pixel format: ").put(stream.pix_fmt.empty() ? "unknown" : stream.pix_fmt).put('\n');
+                if (stream.frame_rate > 0) {
+                    out.put("Frame rate: ").put_double(stream.frame_rate).put(" fps\n");
                 }
                 break;
-                
+
             case AVMEDIA_TYPE_AUDIO:
-                std::cout << "Audio" << std::endl;
-                std::cout << "Sample rate: " << codecpar->sample_rate << " Hz" << std::endl;
-                std::cout << "Channels: " << codecpar->ch_layout.nb_channels << std::endl;
-                std::cout << "Sample format: " << av_get_sample_fmt_name(static_cast<AVSampleFormat>(codecpar->format)) << std::endl;
+                out.put("Audio\n");
+                out.put("Sample rate: ").put_int(stream.sample_rate).put(" Hz\n");
+                out.put("Channels: ").put_int(stream.channels).put('\n');
+                out.put("Sample format: ").put(stream.sample_fmt.empty() ? "unknown" : stream.sample_fmt).put('\n');
                 break;
-                
+
             case AVMEDIA_TYPE_SUBTITLE:
-                std::cout << "Subtitle" << std::endl;
+                out.put("Subtitle\n");
                 break;
-                
+
             default:
-                std::cout << "Unknown" << std::endl;
+                out.put("Unknown\n");
                 break;
         }
-        
-        const AVCodec* codec = avcodec_find_decoder(codecpar->codec_id);
-        if (codec) {
-            std::cout << "Codec: " << codec->name << " (" << codec->long_name << ")" << std::endl;
+
+        if (!stream.decoder_name.empty()) {
+            out.put("Codec: ").put(stream.decoder_name).put(" (").put(stream.decoder_long_name).put(")\n");
         }
-        
-        std::cout << "Bitrate: " << codecpar->bit_rate << " bps" << std::endl;
+
+        out.put("Bitrate: ").put_int(stream.bit_rate).put(" bps\n");
     }
 }
 
-int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_file>" << std::endl;
-        return 1;
+void write_probe_stats(const ProbeStats& stats, OutputBuffer& out) {
+    out.put("\n--- Probe cost ---\n");
+    if (stats.from_cache) {
+        out.put("Answered from cache (lookup ").put_double(stats.cache_lookup_ms).put(" ms)\n");
+        return;
+    }
+    out.put("Header: ").put_int(stats.header_bytes).put(" bytes, ").put_double(stats.header_ms).put(" ms\n");
+    if (stats.stream_info_skipped) {
+        out.put("Stream info: skipped (header complete)\n");
+    } else {
+        out.put("Stream info: ").put_int(stats.stream_info_bytes).put(" bytes, ")
+           .put_double(stats.stream_info_ms).put(" ms\n");
     }
-    
-    const char* input_filename = argv[1];
+    out.put("Total: ").put_int(stats.header_bytes + stats.stream_info_bytes).put(" bytes, ")
+       .put_double(stats.header_ms + stats.stream_info_ms).put(" ms\n");
+}
+
+// One NDJSON record (a single line) per file
+void write_ndjson_record(const std::string& path, const ProbeResult& result, const ProbeStats* stats,
+                         OutputBuffer& out) {
+    out.put("{\"path\":").put_json_string(path);
+    out.put(",\"format\":").put_json_optional(result.format);
+    out.put(",\"duration\":");
+    if (result.duration != AV_NOPTS_VALUE) {
+        out.put_json_double(result.duration / (double)AV_TIME_BASE);
+    } else {
+        out.put("null");
+    }
+    out.put(",\"bit_rate\":").put_int(result.bit_rate);
+    out.put(",\"streams\":[");
+
+    for (size_t i = 0; i < result.streams.size(); i++) {
+        const StreamResult& stream = result.streams[i];
+        const char* type_name = av_get_media_type_string(stream.type);
+
+        if (i > 0) out.put(',');
+        out.put("{\"index\":").put_int(stream.index);
+        out.put(",\"type\":").put_json_string(type_name ? type_name : "unknown");
+        out.put(",\"codec\":").put_json_optional(stream.codec_name);
+        out.put(",\"decoder\":").put_json_optional(stream.decoder_name);
+        out.put(",\"bit_rate\":").put_int(stream.bit_rate);
+        if (stream.type == AVMEDIA_TYPE_VIDEO) {
+            out.put(",\"width\":").put_int(stream.width);
+            out.put(",\"height\":").put_int(stream.height);
+            out.put(",\"pix_fmt\":").put_json_optional(stream.pix_fmt);
+            out.put(",\"frame_rate\":");
+            if (stream.frame_rate > 0) {
+                out.put_json_double(stream.frame_rate);
+            } else {
+                out.put("null");
+            }
+        } else if (stream.type == AVMEDIA_TYPE_AUDIO) {
+            out.put(",\"sample_rate\":").put_int(stream.sample_rate);
+            out.put(",\"channels\":").put_int(stream.channels);
+            out.put(",\"sample_fmt\":").put_json_optional(stream.sample_fmt);
+        }
+        out.put('}');
+    }
+    out.put(']');
+
+    if (stats) {
+        out.put(",\"probe\":{\"header_bytes\":").put_int(stats->header_bytes);
+        out.put(",\"header_ms\":").put_json_double(stats->header_ms);
+        out.put(",\"stream_info_bytes\":").put_int(stats->stream_info_bytes);
+        out.put(",\"stream_info_ms\":").put_json_double(stats->stream_info_ms);
+        out.put(",\"stream_info_skipped\":").put(stats->stream_info_skipped ? "true" : "false");
+        out.put(",\"cached\":").put(stats->from_cache ? "true" : "false");
+        out.put(",\"cache_lookup_ms\":").put_json_double(stats->cache_lookup_ms);
+        out.put('}');
+    }
+    out.put("}\n");
+}
+
+void write_ndjson_error(const std::string& path, const std::string& message, OutputBuffer& out) {
+    out.put("{\"path\":").put_json_string(path);
+    out.put(",\"error\":").put_json_string(message);
+    out.put("}\n");
+}
+
+// Format an AVERROR code with a short context prefix
+std::string format_error(const char* message, int error_code) {
+    char error_buf[AV_ERROR_MAX_STRING_SIZE];
+    av_strerror(error_code, error_buf, AV_ERROR_MAX_STRING_SIZE);
+    return std::string(message) + ": " + error_buf;
+}
+
+// Open a file and read its stream information into result.
+// Returns 0 on success or a negative AVERROR code with error set.
+int probe_file(const char* input_filename, const ProbeOptions& options, ProbeResult& result,
+               ProbeStats& stats, std::string& error) {
     AVFormatContext* format_ctx = nullptr;
-    
-    std::cout << "FFmpeg version: " << av_version_info() << std::endl;
-    std::cout << "Analyzing file: " << input_filename << std::endl << std::endl;
-    
-    // Open input file
-    int ret = avformat_open_input(&format_ctx, input_filename, nullptr, nullptr);
+    AVDictionary* format_opts = nullptr;
+
+    // Apply the probe budget; the same limits bound avformat_find_stream_info
+    int64_t probesize = options.probesize;
+    int64_t analyzeduration = options.analyzeduration;
+    if (options.fast) {
+        if (probesize < 0) probesize = FAST_PROBESIZE;
+        if (analyzeduration < 0) analyzeduration = FAST_ANALYZEDURATION;
+        // Scanning the file tail for the last timestamps costs extra seeks and reads
+        av_dict_set(&format_opts, "skip_estimate_duration_from_pts", "1", 0);
+    }
+    if (probesize >= 0) {
+        av_dict_set_int(&format_opts, "probesize", probesize, 0);
+    }
+    if (analyzeduration >= 0) {
+        av_dict_set_int(&format_opts, "analyzeduration", analyzeduration, 0);
+    }
+
+    // Open input file (reads the container header, e.g. MP4 moov or Matroska Cues)
+    auto phase_start = std::chrono::steady_clock::now();
+    int ret = avformat_open_input(&format_ctx, input_filename, nullptr, &format_opts);
+    av_dict_free(&format_opts);
     if (ret < 0) {
-        char error_buf[AV_ERROR_MAX_STRING_SIZE];
-        av_strerror(ret, error_buf, AV_ERROR_MAX_STRING_SIZE);
-        std::cerr << "Error opening file: " << error_buf << std::endl;
+        error = format_error("Error opening file", ret);
+        return ret;
+    }
+    auto phase_end = std::chrono::steady_clock::now();
+    stats.header_ms = std::chrono::duration<double, std::milli>(phase_end - phase_start).count();
+    stats.header_bytes = format_ctx->pb ? format_ctx->pb->bytes_read : 0;
+
+    // Retrieve stream information, unless fast mode already has everything from the header
+    stats.stream_info_skipped = options.fast && header_is_complete(format_ctx);
+    if (!stats.stream_info_skipped) {
+        phase_start = std::chrono::steady_clock::now();
+        ret = avformat_find_stream_info(format_ctx, nullptr);
+        if (ret < 0) {
+            error = format_error("Error finding stream info", ret);
+            avformat_close_input(&format_ctx);
+            return ret;
+        }
+        phase_end = std::chrono::steady_clock::now();
+        stats.stream_info_ms = std::chrono::duration<double, std::milli>(phase_end - phase_start).count();
+        stats.stream_info_bytes = (format_ctx->pb ? format_ctx->pb->bytes_read : 0) - stats.header_bytes;
+    }
+
+    collect_probe_result(format_ctx, result);
+
+    // Cleanup
+    avformat_close_input(&format_ctx);
+    return 0;
+}
+
+// Identity of a file on disk. A cached result is only reused while all of
+// these still match, so edited or replaced files are probed again.
+struct FileIdentity {
+    uint64_t size = 0;
+    int64_t mtime = 0;          // last_write_time in the file clock's native ticks
+    uint64_t partial_hash = 0;  // FNV-1a of the first and last 64 KiB (0 = not computed)
+};
+
+const size_t PARTIAL_HASH_BLOCK = 64 * 1024;
+
+uint64_t fnv1a_update(uint64_t hash, const unsigned char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool get_file_identity(const std::string& path, bool with_hash, FileIdentity& identity) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+
+    identity.size = fs::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    auto mtime = fs::last_write_time(path, ec);
+    if (ec) {
+        return false;
+    }
+    identity.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+    identity.partial_hash = 0;
+
+    if (with_hash) {
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) {
+            return false;
+        }
+        std::vector<unsigned char> block(PARTIAL_HASH_BLOCK);
+        uint64_t hash = 14695981039346656037ULL;
+        size_t head = std::fread(block.data(), 1, block.size(), file);
+        hash = fnv1a_update(hash, block.data(), head);
+        if (identity.size > 2 * PARTIAL_HASH_BLOCK &&
+            std::fseek(file, -static_cast<long>(PARTIAL_HASH_BLOCK), SEEK_END) == 0) {
+            size_t tail = std::fread(block.data(), 1, block.size(), file);
+            hash = fnv1a_update(hash, block.data(), tail);
+        }
+        std::fclose(file);
+        // Reserve 0 for "no hash"
+        identity.partial_hash = hash ? hash : 1;
+    }
+    return true;
+}
+
+// Persistent probe result cache.
+//
+// File layout (host byte order, the cache is meant for the machine that wrote it):
+//   "FFICACHE" + u32 version, then records of [u32 payload size][payload].
+//   payload = path, size, mtime, partial hash, fast flag, serialized ProbeResult.
+// The file is memory-mapped on load and only an index of path -> record offset
+// is built; a record is decoded when it is looked up. New results are appended
+// on save, later records override earlier ones for the same path, and the file
+// is rewritten once more than half of it is superseded.
+class ProbeCache {
+private:
+    static constexpr char MAGIC[8] = {'F', 'F', 'I', 'C', 'A', 'C', 'H', 'E'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = sizeof(MAGIC) + sizeof(uint32_t);
+
+    std::string cache_path;
+    const char* data = nullptr;
+    size_t data_size = 0;
+#ifdef _WIN32
+    std::vector<char> file_data;
+#endif
+    std::unordered_map<std::string_view, size_t> index;  // path -> payload offset
+    size_t record_count = 0;
+
+    std::mutex pending_mutex;
+    std::string pending;            // Serialized records added during this run
+    std::unordered_set<std::string> pending_paths;
+
+    std::atomic<int> hits{0};
+    std::atomic<int> misses{0};
+    std::atomic<int64_t> lookup_ns{0};
+
+    // Bounds-checked reader over a mapped record
+    struct Reader {
+        const char* pos;
+        const char* end;
+        bool ok = true;
+
+        template <typename T>
+        T get() {
+            T value{};
+            if (end - pos < static_cast<ptrdiff_t>(sizeof(T))) {
+                ok = false;
+                return value;
+            }
+            std::memcpy(&value, pos, sizeof(T));
+            pos += sizeof(T);
+            return value;
+        }
+
+        std::string_view get_string() {
+            uint32_t length = get<uint32_t>();
+            if (!ok || end - pos < static_cast<ptrdiff_t>(length)) {
+                ok = false;
+                return {};
+            }
+            std::string_view text(pos, length);
+            pos += length;
+            return text;
+        }
+    };
+
+    template <typename T>
+    static void put(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    static void put_string(std::string& out, std::string_view text) {
+        put<uint32_t>(out, static_cast<uint32_t>(text.size()));
+        out.append(text.data(), text.size());
+    }
+
+    static void serialize(const std::string& path, const FileIdentity& identity, bool fast,
+                          const ProbeResult& result, std::string& out) {
+        std::string payload;
+        put_string(payload, path);
+        put<uint64_t>(payload, identity.size);
+        put<int64_t>(payload, identity.mtime);
+        put<uint64_t>(payload, identity.partial_hash);
+        put<uint8_t>(payload, fast ? 1 : 0);
+
+        put_string(payload, result.format);
+        put<int64_t>(payload, result.duration);
+        put<int64_t>(payload, result.bit_rate);
+        put<uint32_t>(payload, static_cast<uint32_t>(result.streams.size()));
+        for (const StreamResult& stream : result.streams) {
+            put<int32_t>(payload, stream.index);
+            put<int32_t>(payload, stream.type);
+            put_string(payload, stream.codec_name);
+            put_string(payload, stream.decoder_name);
+            put_string(payload, stream.decoder_long_name);
+            put<int64_t>(payload, stream.bit_rate);
+            put<int32_t>(payload, stream.width);
+            put<int32_t>(payload, stream.height);
+            put_string(payload, stream.pix_fmt);
+            put<double>(payload, stream.frame_rate);
+            put<int32_t>(payload, stream.sample_rate);
+            put<int32_t>(payload, stream.channels);
+            put_string(payload, stream.sample_fmt);
+        }
+
+        put<uint32_t>(out, static_cast<uint32_t>(payload.size()));
+        out.append(payload);
+    }
+
+    bool map_file() {
+#ifdef _WIN32
+        std::ifstream in(cache_path, std::ios::binary);
+        if (!in) {
+            return false;
+        }
+        file_data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data = file_data.data();
+        data_size = file_data.size();
+        return true;
+#else
+        int fd = open(cache_path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            close(fd);
+            return false;
+        }
+        void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            return false;
+        }
+        data = static_cast<const char*>(mapping);
+        data_size = st.st_size;
+        return true;
+#endif
+    }
+
+    void unmap_file() {
+#ifdef _WIN32
+        file_data.clear();
+#else
+        if (data) {
+            munmap(const_cast<char*>(data), data_size);
+        }
+#endif
+        data = nullptr;
+        data_size = 0;
+    }
+
+public:
+    explicit ProbeCache(std::string path) : cache_path(std::move(path)) {}
+
+    ~ProbeCache() {
+        unmap_file();
+    }
+
+    // Map the cache file and index its records. A missing file is an empty cache.
+    bool load() {
+        if (!map_file()) {
+            return true;
+        }
+        if (data_size < HEADER_SIZE || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+            std::cerr << "Ignoring invalid probe cache: " << cache_path << std::endl;
+            unmap_file();
+            return true;
+        }
+        uint32_t version;
+        std::memcpy(&version, data + sizeof(MAGIC), sizeof(version));
+        if (version != VERSION) {
+            std::cerr << "Ignoring probe cache with version " << version << ": " << cache_path << std::endl;
+            unmap_file();
+            return true;
+        }
+
+        Reader reader{data + HEADER_SIZE, data + data_size};
+        while (reader.pos < reader.end) {
+            uint32_t payload_size = reader.get<uint32_t>();
+            if (!reader.ok || reader.end - reader.pos < static_cast<ptrdiff_t>(payload_size)) {
+                // Truncated tail (e.g. an interrupted save); keep what was complete
+                break;
+            }
+            Reader record{reader.pos, reader.pos + payload_size};
+            std::string_view path = record.get_string();
+            if (record.ok) {
+                index[path] = reader.pos - data;
+                record_count++;
+            }
+            reader.pos += payload_size;
+        }
+        return true;
+    }
+
+    // Fetch a result for path if the file has not changed since it was cached
+    bool lookup(const std::string& path, const FileIdentity& identity, bool fast, ProbeResult& result) {
+        auto it = index.find(path);
+        if (it == index.end()) {
+            return false;
+        }
+
+        Reader reader{data + it->second, data + data_size};
+        reader.get_string();
+        uint64_t size = reader.get<uint64_t>();
+        int64_t mtime = reader.get<int64_t>();
+        uint64_t partial_hash = reader.get<uint64_t>();
+        bool record_fast = reader.get<uint8_t>() != 0;
+        if (!reader.ok || size != identity.size || mtime != identity.mtime ||
+            (identity.partial_hash != 0 && partial_hash != identity.partial_hash)) {
+            return false;
+        }
+        // A header-only result cannot answer a full probe
+        if (record_fast && !fast) {
+            return false;
+        }
+
+        result.format = reader.get_string();
+        result.duration = reader.get<int64_t>();
+        result.bit_rate = reader.get<int64_t>();
+        uint32_t stream_count = reader.get<uint32_t>();
+        result.streams.clear();
+        for (uint32_t i = 0; i < stream_count && reader.ok; i++) {
+            StreamResult stream;
+            stream.index = reader.get<int32_t>();
+            stream.type = static_cast<AVMediaType>(reader.get<int32_t>());
+            stream.codec_name = reader.get_string();
+            stream.decoder_name = reader.get_string();
+            stream.decoder_long_name = reader.get_string();
+            stream.bit_rate = reader.get<int64_t>();
+            stream.width = reader.get<int32_t>();
+            stream.height = reader.get<int32_t>();
+            stream.pix_fmt = reader.get_string();
+            stream.frame_rate = reader.get<double>();
+            stream.sample_rate = reader.get<int32_t>();
+            stream.channels = reader.get<int32_t>();
+            stream.sample_fmt = reader.get_string();
+            result.streams.push_back(std::move(stream));
+        }
+        return reader.ok;
+    }
+
+    // Queue a fresh probe result; thread-safe
+    void store(const std::string& path, const FileIdentity& identity, bool fast, const ProbeResult& result) {
+        std::string record;
+        serialize(path, identity, fast, result, record);
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        pending.append(record);
+        pending_paths.insert(path);
+    }
+
+    void record_lookup(bool hit, int64_t elapsed_ns) {
+        (hit ? hits : misses)++;
+        lookup_ns += elapsed_ns;
+    }
+
+    // Append queued results, or rewrite the file when most of it is superseded
+    bool save() {
+        if (pending_paths.empty()) {
+            return true;
+        }
+
+        size_t stale = record_count - index.size();
+        bool rewrite = !data || stale > index.size();
+
+        if (!rewrite) {
+            FILE* file = std::fopen(cache_path.c_str(), "ab");
+            if (!file) {
+                std::cerr << "Could not update probe cache: " << cache_path << std::endl;
+                return false;
+            }
+            bool ok = std::fwrite(pending.data(), 1, pending.size(), file) == pending.size();
+            ok = std::fclose(file) == 0 && ok;
+            return ok;
+        }
+
+        // Keep the latest record of every path not re-probed in this run
+        std::string temp_path = cache_path + ".tmp";
+        FILE* file = std::fopen(temp_path.c_str(), "wb");
+        if (!file) {
+            std::cerr << "Could not write probe cache: " << temp_path << std::endl;
+            return false;
+        }
+        bool ok = std::fwrite(MAGIC, 1, sizeof(MAGIC), file) == sizeof(MAGIC);
+        ok = ok && std::fwrite(&VERSION, sizeof(VERSION), 1, file) == 1;
+        for (const auto& entry : index) {
+            if (pending_paths.count(std::string(entry.first))) {
+                continue;
+            }
+            const char* record = data + entry.second - sizeof(uint32_t);
+            uint32_t payload_size;
+            std::memcpy(&payload_size, record, sizeof(payload_size));
+            size_t record_size = sizeof(uint32_t) + payload_size;
+            ok = ok && std::fwrite(record, 1, record_size, file) == record_size;
+        }
+        ok = ok && std::fwrite(pending.data(), 1, pending.size(), file) == pending.size();
+        ok = std::fclose(file) == 0 && ok;
+
+        std::error_code ec;
+        if (ok) {
+            unmap_file();
+            std::filesystem::rename(temp_path, cache_path, ec);
+        }
+        if (!ok || ec) {
+            std::cerr << "Could not write probe cache: " << cache_path << std::endl;
+            std::filesystem::remove(temp_path, ec);
+            return false;
+        }
+        return true;
+    }
+
+    void print_summary() const {
+        int total = hits + misses;
+        std::cerr << "Cache: " << hits << " hits, " << misses << " misses";
+        if (total > 0) {
+            std::cerr << " (" << 100.0 * hits / total << "% hit rate, "
+                      << lookup_ns / total / 1000.0 << " us average lookup)";
+        }
+        std::cerr << ", " << index.size() << " entries loaded" << std::endl;
+    }
+};
+
+// Answer from the cache when the file is unchanged, otherwise probe it and
+// queue the result for the cache. Returns 0 or a negative AVERROR code.
+int probe_with_cache(const std::string& path, const ProbeOptions& options, ProbeCache* cache,
+                     ProbeResult& result, ProbeStats& stats, std::string& error) {
+    if (!cache) {
+        return probe_file(path.c_str(), options, result, stats, error);
+    }
+
+    auto lookup_start = std::chrono::steady_clock::now();
+    FileIdentity identity;
+    bool have_identity = get_file_identity(path, options.cache_verify, identity);
+    bool hit = have_identity && cache->lookup(path, identity, options.fast, result);
+    auto lookup_time = std::chrono::steady_clock::now() - lookup_start;
+
+    cache->record_lookup(hit, std::chrono::duration_cast<std::chrono::nanoseconds>(lookup_time).count());
+    stats.cache_lookup_ms = std::chrono::duration<double, std::milli>(lookup_time).count();
+    if (hit) {
+        stats.from_cache = true;
+        return 0;
+    }
+
+    int ret = probe_file(path.c_str(), options, result, stats, error);
+    if (ret >= 0 && have_identity) {
+        cache->store(path, identity, options.fast, result);
+    }
+    return ret;
+}
+
+// Render one probed file in the selected output format
+void write_report(const std::string& path, const ProbeOptions& options, const ProbeResult& result,
+                  const ProbeStats& stats, bool batch_mode, OutputBuffer& out) {
+    if (options.ndjson) {
+        write_ndjson_record(path, result, options.report_cost ? &stats : nullptr, out);
+        return;
+    }
+
+    if (batch_mode) {
+        out.put("File: ").put(path).put('\n');
+    }
+    write_stream_info(result, out);
+    if (options.report_cost) {
+        write_probe_stats(stats, out);
+    }
+    if (batch_mode) {
+        out.put('\n');
+    }
+}
+
+// Per-thread state of the batch prober. Each worker keeps its own result and
+// output buffer and reuses them for every file, so finished reports can be
+// written out with a single call while holding the output lock.
+struct ProbeWorker {
+    ProbeResult result;
+    OutputBuffer out;
+    std::string error;
+    int probed = 0;
+    int failed = 0;
+    int64_t bytes_read = 0;
+};
+
+// Expand the command line inputs into a flat list of files.
+// Directories are walked recursively, list files hold one path per line
+// ("-" reads the list from stdin, blank lines and '#' comments are skipped).
+bool collect_inputs(const std::vector<std::string>& inputs, const std::vector<std::string>& list_files,
+                    std::vector<std::string>& files) {
+    namespace fs = std::filesystem;
+
+    for (const std::string& list_file : list_files) {
+        std::ifstream list_stream;
+        if (list_file != "-") {
+            list_stream.open(list_file);
+            if (!list_stream) {
+                std::cerr << "Could not open file list: " << list_file << std::endl;
+                return false;
+            }
+        }
+        std::istream& in = (list_file == "-") ? std::cin : list_stream;
+
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            files.push_back(line);
+        }
+    }
+
+    for (const std::string& input : inputs) {
+        std::error_code ec;
+        if (fs::is_directory(input, ec)) {
+            std::vector<std::string> dir_files;
+            for (fs::recursive_directory_iterator it(input, fs::directory_options::skip_permission_denied, ec), end;
+                 it != end; it.increment(ec)) {
+                if (ec) {
+                    break;
+                }
+                if (it->is_regular_file(ec)) {
+                    dir_files.push_back(it->path().string());
+                }
+            }
+            if (ec) {
+                std::cerr << "Could not read directory " << input << ": " << ec.message() << std::endl;
+                return false;
+            }
+            // Directory order is unspecified; sort so runs are reproducible
+            std::sort(dir_files.begin(), dir_files.end());
+            files.insert(files.end(), dir_files.begin(), dir_files.end());
+        } else {
+            files.push_back(input);
+        }
+    }
+
+    return true;
+}
+
+// Probe every file on a bounded pool of worker threads.
+// Workers pull the next file index from a shared counter and stream each
+// report to stdout as soon as it is finished (completion order, not input order).
+int run_batch(const std::vector<std::string>& files, const ProbeOptions& options, ProbeCache* cache, int jobs) {
+    const size_t worker_count = std::min(files.size(), static_cast<size_t>(jobs));
+    std::vector<ProbeWorker> workers(worker_count);
+    std::vector<std::thread> threads;
+    std::atomic<size_t> next_index{0};
+    std::mutex output_mutex;
+
+    // Keep libav* warnings from interleaving with the reports
+    av_log_set_level(AV_LOG_ERROR);
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    for (size_t w = 0; w < worker_count; w++) {
+        threads.emplace_back([&, w]() {
+            ProbeWorker& worker = workers[w];
+
+            while (true) {
+                size_t index = next_index.fetch_add(1);
+                if (index >= files.size()) {
+                    break;
+                }
+
+                const std::string& filename = files[index];
+                worker.out.clear();
+
+                ProbeStats stats;
+                int ret = probe_with_cache(filename, options, cache, worker.result, stats, worker.error);
+                worker.probed++;
+                worker.bytes_read += stats.header_bytes + stats.stream_info_bytes;
+                if (ret < 0) {
+                    worker.failed++;
+                    if (options.ndjson) {
+                        write_ndjson_error(filename, worker.error, worker.out);
+                    }
+                } else {
+                    write_report(filename, options, worker.result, stats, true, worker.out);
+                }
+
+                std::lock_guard<std::mutex> lock(output_mutex);
+                if (ret < 0 && !options.ndjson) {
+                    std::cerr << filename << ": " << worker.error << std::endl;
+                }
+                worker.out.write_to(stdout);
+            }
+        });
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    int probed = 0;
+    int failed = 0;
+    int64_t bytes_read = 0;
+    for (const ProbeWorker& worker : workers) {
+        probed += worker.probed;
+        failed += worker.failed;
+        bytes_read += worker.bytes_read;
+    }
+
+    std::cerr << "Probed " << probed << " files (" << failed << " failed) in " << elapsed
+              << " s with " << worker_count << " threads";
+    if (elapsed > 0) {
+        std::cerr << " (" << probed / elapsed << " files/s)";
+    }
+    std::cerr << std::endl;
+    if (probed > 0) {
+        std::cerr << "Read " << bytes_read << " bytes (" << bytes_read / probed << " bytes/file)" << std::endl;
+    }
+
+    return failed > 0 ? 1 : 0;
+}
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " <input_file>" << std::endl;
+    std::cerr << "       " << program << " [-j <threads>] [--list <file|->] <file|directory>..." << std::endl;
+    std::cerr << "  -j, --jobs <n>   Number of probe threads in batch mode (default: CPU count)" << std::endl;
+    std::cerr << "  --list <file>    Read input paths from a file, one per line ('-' for stdin)" << std::endl;
+    std::cerr << "  --fast           Read only the container header; analyze streams only if it is incomplete" << std::endl;
+    std::cerr << "  --probesize <bytes>        Cap bytes read while probing (--fast default: "
+              << FAST_PROBESIZE << ")" << std::endl;
+    std::cerr << "  --analyzeduration <usec>   Cap stream time analyzed (--fast default: "
+              << FAST_ANALYZEDURATION << ")" << std::endl;
+    std::cerr << "  --stats          Report bytes read and time spent per probe phase (implied by --fast)" << std::endl;
+    std::cerr << "  --format <text|ndjson>     Output format (default: text; ndjson writes one JSON record per file)" << std::endl;
+    std::cerr << "  --cache <file>   Reuse results for files whose path, size and mtime are unchanged" << std::endl;
+    std::cerr << "  --cache-verify   Also match a hash of the first/last 64 KiB of each file" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> inputs;
+    std::vector<std::string> list_files;
+    ProbeOptions options;
+    int jobs = static_cast<int>(std::thread::hardware_concurrency());
+    if (jobs <= 0) {
+        jobs = 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+            jobs = std::atoi(argv[++i]);
+            if (jobs <= 0) {
+                std::cerr << "Thread count must be positive" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--list" && i + 1 < argc) {
+            list_files.push_back(argv[++i]);
+        } else if (arg == "--fast") {
+            options.fast = true;
+            options.report_cost = true;
+        } else if (arg == "--format" && i + 1 < argc) {
+            std::string format = argv[++i];
+            if (format == "ndjson" || format == "json") {
+                options.ndjson = true;
+            } else if (format == "text") {
+                options.ndjson = false;
+            } else {
+                std::cerr << "Unknown output format: " << format << std::endl;
+                return 1;
+            }
+        } else if (arg == "--cache" && i + 1 < argc) {
+            options.cache_path = argv[++i];
+        } else if (arg == "--cache-verify") {
+            options.cache_verify = true;
+        } else if (arg == "--stats") {
+            options.report_cost = true;
+        } else if (arg == "--probesize" && i + 1 < argc) {
+            options.probesize = std::atoll(argv[++i]);
+            if (options.probesize < 32) {
+                std::cerr << "Probe size must be at least 32 bytes" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--analyzeduration" && i + 1 < argc) {
+            options.analyzeduration = std::atoll(argv[++i]);
+            if (options.analyzeduration < 0) {
+                std::cerr << "Analyze duration must not be negative" << std::endl;
+                return 1;
+            }
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (inputs.empty() && list_files.empty()) {
+        print_usage(argv[0]);
         return 1;
     }
-    
-    // Retrieve stream information
-    ret = avformat_find_stream_info(format_ctx, nullptr);
+
+    std::unique_ptr<ProbeCache> cache;
+    if (!options.cache_path.empty()) {
+        cache = std::make_unique<ProbeCache>(options.cache_path);
+        cache->load();
+    }
+
+    // A single plain file keeps the original one-shot report
+    std::error_code ec;
+    bool batch_mode = !list_files.empty() || inputs.size() > 1 || std::filesystem::is_directory(inputs[0], ec);
+
+    if (batch_mode) {
+        std::vector<std::string> files;
+        if (!collect_inputs(inputs, list_files, files)) {
+            return 1;
+        }
+        if (files.empty()) {
+            std::cerr << "No input files found" << std::endl;
+            return 1;
+        }
+        int ret = run_batch(files, options, cache.get(), jobs);
+        if (cache) {
+            cache->save();
+            cache->print_summary();
+        }
+        return ret;
+    }
+
+    const std::string& input_filename = inputs[0];
+    ProbeResult result;
+    ProbeStats stats;
+    std::string error;
+    OutputBuffer out;
+
+    int ret = probe_with_cache(input_filename, options, cache.get(), result, stats, error);
+    if (cache) {
+        cache->save();
+        cache->print_summary();
+    }
+
+    if (options.ndjson) {
+        if (ret < 0) {
+            write_ndjson_error(input_filename, error, out);
+        } else {
+            write_report(input_filename, options, result, stats, false, out);
+        }
+        out.write_to(stdout);
+        return ret < 0 ? 1 : 0;
+    }
+
+    out.put("FFmpeg version: ").put(av_version_info()).put('\n');
+    out.put("Analyzing file: ").put(input_filename).put("\n\n");
     if (ret < 0) {
-        char error_buf[AV_ERROR_MAX_STRING_SIZE];
-        av_strerror(ret, error_buf, AV_ERROR_MAX_STRING_SIZE);
-        std::cerr << "Error finding stream info: " << error_buf << std::endl;
-        avformat_close_input(&format_ctx);
+        out.write_to(stdout);
+        std::fflush(stdout);
+        std::cerr << error << std::endl;
         return 1;
     }
-    
-    // Print file information
-    print_stream_info(format_ctx);
-    
-    // Cleanup
-    avformat_close_input(&format_ctx);
-    
-    std::cout << "\nAnalysis complete!" << std::endl;
+
+    write_report(input_filename, options, result, stats, false, out);
+    out.put("\nAnalysis complete!\n");
+    out.write_to(stdout);
     return 0;
 }